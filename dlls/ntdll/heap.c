@@ -251,7 +251,11 @@ C_ASSERT( BLOCK_BIN_SIZE( 0x80 ) == ~(SIZE_T)0 );
 C_ASSERT( BIN_SIZE_STEP_7 + 3 * BLOCK_ALIGN <= FIELD_MAX( struct block, tail_size ) );
 
 static BYTE affinity_mapping[] = {20,6,31,15,14,29,27,4,18,24,26,13,0,9,2,30,17,7,23,25,10,19,12,3,22,21,5,16,1,28,11,8};
-static LONG next_thread_affinity;
+static LONG next_thread_affinity[ARRAY_SIZE(affinity_mapping)];
+
+/* NUMA node of each processor, affinities are split in contiguous ranges of the mapping between nodes */
+static BYTE processor_node[sizeof(KAFFINITY) * 8];
+static ULONG node_count = 1;
 
 /* a bin, tracking heap blocks of a certain size */
 struct bin
@@ -1494,6 +1498,31 @@ static void heap_set_debug_flags( HANDLE handle )
 }
 
 
+static void heap_init_numa_nodes(void)
+{
+    LOGICAL_PROCESSOR_RELATIONSHIP relation = RelationNumaNode;
+    SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *info;
+    char buffer[1024];
+    ULONG i, len, pos, count = 0;
+
+    if (NtQuerySystemInformationEx( SystemLogicalProcessorInformationEx, &relation, sizeof(relation),
+                                    buffer, sizeof(buffer), &len ))
+        return;
+
+    for (pos = 0; pos < len && count < ARRAY_SIZE(affinity_mapping); pos += info->Size)
+    {
+        info = (SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *)(buffer + pos);
+        if (info->Relationship != RelationNumaNode || info->u.NumaNode.GroupMask.Group) continue;
+
+        for (i = 0; i < ARRAY_SIZE(processor_node); i++)
+            if (info->u.NumaNode.GroupMask.Mask & ((KAFFINITY)1 << i)) processor_node[i] = count;
+        count++;
+    }
+
+    if (count > 1) node_count = count;
+    TRACE( "%lu NUMA nodes\n", node_count );
+}
+
 /***********************************************************************
  *           RtlCreateHeap   (NTDLL.@)
  *
@@ -1608,6 +1637,7 @@ HANDLE WINAPI RtlCreateHeap( ULONG flags, void *addr, SIZE_T total_size, SIZE_T
     {
         process_heap = heap;  /* assume the first heap we create is the process main heap */
         list_init( &process_heap->entry );
+        heap_init_numa_nodes();
     }
 
     return heap;
@@ -1862,8 +1892,18 @@ static inline ULONG heap_current_thread_affinity(void)
 
     if (!(affinity = NtCurrentTeb()->HeapVirtualAffinity))
     {
-        affinity = InterlockedIncrement( &next_thread_affinity );
-        affinity = affinity_mapping[affinity % ARRAY_SIZE(affinity_mapping)];
+        ULONG node = 0, slots = ARRAY_SIZE(affinity_mapping) / node_count;
+
+        /* give threads running on the same node affinities from the same range, so
+         * that the groups they reserve are only reused by threads of that node. */
+        if (node_count > 1)
+        {
+            ULONG processor = NtGetCurrentProcessorNumber();
+            if (processor < ARRAY_SIZE(processor_node)) node = processor_node[processor];
+        }
+
+        affinity = InterlockedIncrement( &next_thread_affinity[node] );
+        affinity = affinity_mapping[node * slots + affinity % slots];
         NtCurrentTeb()->HeapVirtualAffinity = affinity;
     }
 
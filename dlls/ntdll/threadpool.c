@@ -30,6 +30,7 @@
 
 #include "wine/debug.h"
 #include "wine/list.h"
+#include "wine/rbtree.h"
 
 #include "ntdll_misc.h"
 
@@ -73,12 +74,14 @@ struct queue_timer
 {
     struct timer_queue *q;
     struct list entry;
+    struct rb_entry expire_entry; /* entry in the expiration tree, unless expire == EXPIRE_NEVER */
     ULONG runcount;             /* number of callbacks pending execution */
     RTL_WAITORTIMERCALLBACKFUNC callback;
     PVOID param;
     DWORD period;
     ULONG flags;
     ULONGLONG expire;
+    ULONGLONG seq;              /* sequence number for ordering timers with the same expiration */
     BOOL destroy;               /* timer should be deleted; once set, never unset */
     HANDLE event;               /* removal event */
 };
@@ -87,7 +90,9 @@ struct timer_queue
 {
     DWORD magic;
     RTL_CRITICAL_SECTION cs;
-    struct list timers;         /* sorted by expiration time */
+    struct list timers;         /* all timers of the queue */
+    struct rb_tree expire_tree; /* armed timers, sorted by expiration time */
+    ULONGLONG timer_seq;        /* sequence number of the last armed timer */
     BOOL quit;                  /* queue should be deleted; once set, never unset */
     HANDLE event;
     HANDLE thread;
@@ -178,9 +183,10 @@ struct threadpool_object
             /* information about the timer, locked via timerqueue.cs */
             BOOL            timer_initialized;
             BOOL            timer_pending;
-            struct list     timer_entry;
+            struct rb_entry timer_entry;
             BOOL            timer_set;
             ULONGLONG       timeout;
+            ULONGLONG       seq;
             LONG            period;
             LONG            window_length;
         } timer;
@@ -239,12 +245,15 @@ struct threadpool_group
 /* global timerqueue object */
 static RTL_CRITICAL_SECTION_DEBUG timerqueue_debug;
 
+static int compare_pending_timers( const void *key, const struct rb_entry *entry );
+
 static struct
 {
     CRITICAL_SECTION        cs;
     LONG                    objcount;
     BOOL                    thread_running;
-    struct list             pending_timers;
+    struct rb_tree          pending_timers;
+    ULONGLONG               timer_seq;
     RTL_CONDITION_VARIABLE  update_event;
 }
 timerqueue =
@@ -252,7 +261,8 @@ timerqueue =
     { &timerqueue_debug, -1, 0, 0, 0, 0 },      /* cs */
     0,                                          /* objcount */
     FALSE,                                      /* thread_running */
-    LIST_INIT( timerqueue.pending_timers ),     /* pending_timers */
+    { compare_pending_timers, NULL },           /* pending_timers */
+    0,                                          /* timer_seq */
     RTL_CONDITION_VARIABLE_INIT                 /* update_event */
 };
 
@@ -270,7 +280,7 @@ static struct
 {
     CRITICAL_SECTION        cs;
     LONG                    num_buckets;
-    struct list             buckets;
+    struct list             buckets;    /* buckets with free slots are kept before full ones */
 }
 waitqueue =
 {
@@ -557,6 +567,22 @@ static inline PLARGE_INTEGER get_nt_timeout( PLARGE_INTEGER pTime, ULONG timeout
 
 /************************** Timer Queue Impl **************************/
 
+static int compare_queue_timers(const void *key, const struct rb_entry *entry)
+{
+    const struct queue_timer *a = key;
+    const struct queue_timer *b = RB_ENTRY_VALUE(entry, const struct queue_timer, expire_entry);
+
+    if (a->expire != b->expire) return a->expire < b->expire ? -1 : 1;
+    if (a->seq != b->seq) return a->seq < b->seq ? -1 : 1;
+    return 0;
+}
+
+static inline struct queue_timer *queue_first_timer(struct timer_queue *q)
+{
+    struct rb_entry *head = rb_head(q->expire_tree.root);
+    return head ? RB_ENTRY_VALUE(head, struct queue_timer, expire_entry) : NULL;
+}
+
 static void queue_remove_timer(struct queue_timer *t)
 {
     /* We MUST hold the queue cs while calling this function.  This ensures
@@ -568,6 +594,8 @@ static void queue_remove_timer(struct queue_timer *t)
     assert(t->destroy);
 
     list_remove(&t->entry);
+    if (t->expire != EXPIRE_NEVER)
+        rb_remove(&q->expire_tree, &t->expire_entry);
     if (t->event)
         NtSetEvent(t->event, NULL);
     RtlFreeHeap(GetProcessHeap(), 0, t);
@@ -608,26 +636,22 @@ static inline ULONGLONG queue_current_time(void)
 static void queue_add_timer(struct queue_timer *t, ULONGLONG time,
                             BOOL set_event)
 {
-    /* We MUST hold the queue cs while calling this function.  */
+    /* We MUST hold the queue cs while calling this function.  The timer
+       must not be in the expiration tree yet.  */
     struct timer_queue *q = t->q;
-    struct list *ptr = &q->timers;
 
     assert(!q->quit || (t->destroy && time == EXPIRE_NEVER));
 
-    if (time != EXPIRE_NEVER)
-        LIST_FOR_EACH(ptr, &q->timers)
-        {
-            struct queue_timer *cur = LIST_ENTRY(ptr, struct queue_timer, entry);
-            if (time < cur->expire)
-                break;
-        }
-    list_add_before(ptr, &t->entry);
-
     t->expire = time;
+    if (time == EXPIRE_NEVER)
+        return;
+
+    t->seq = ++q->timer_seq;
+    rb_put(&q->expire_tree, t, &t->expire_entry);
 
-    /* If we insert at the head of the list, we need to expire sooner
+    /* If we insert at the head of the tree, we need to expire sooner
        than expected.  */
-    if (set_event && &t->entry == list_head(&q->timers))
+    if (set_event && queue_first_timer(q) == t)
         NtSetEvent(q->event, NULL);
 }
 
@@ -635,7 +659,8 @@ static inline void queue_move_timer(struct queue_timer *t, ULONGLONG time,
                                     BOOL set_event)
 {
     /* We MUST hold the queue cs while calling this function.  */
-    list_remove(&t->entry);
+    if (t->expire != EXPIRE_NEVER)
+        rb_remove(&t->q->expire_tree, &t->expire_entry);
     queue_add_timer(t, time, set_event);
 }
 
@@ -644,10 +669,9 @@ static void queue_timer_expire(struct timer_queue *q)
     struct queue_timer *t = NULL;
 
     RtlEnterCriticalSection(&q->cs);
-    if (list_head(&q->timers))
+    if ((t = queue_first_timer(q)))
     {
         ULONGLONG now, next;
-        t = LIST_ENTRY(list_head(&q->timers), struct queue_timer, entry);
         if (!t->destroy && t->expire <= ((now = queue_current_time())))
         {
             ++t->runcount;
@@ -690,16 +714,11 @@ static ULONG queue_get_timeout(struct timer_queue *q)
     ULONG timeout = INFINITE;
 
     RtlEnterCriticalSection(&q->cs);
-    if (list_head(&q->timers))
+    if ((t = queue_first_timer(q)))
     {
-        t = LIST_ENTRY(list_head(&q->timers), struct queue_timer, entry);
-        assert(!t->destroy || t->expire == EXPIRE_NEVER);
-
-        if (t->expire != EXPIRE_NEVER)
-        {
-            ULONGLONG time = queue_current_time();
-            timeout = t->expire < time ? 0 : t->expire - time;
-        }
+        ULONGLONG time = queue_current_time();
+        assert(!t->destroy);
+        timeout = t->expire < time ? 0 : t->expire - time;
     }
     RtlLeaveCriticalSection(&q->cs);
 
@@ -760,7 +779,7 @@ static void queue_destroy_timer(struct queue_timer *t)
         queue_remove_timer(t);
     else
         /* Make sure no destroyed timer masks an active timer at the head
-           of the sorted list.  */
+           of the expiration tree.  */
         queue_move_timer(t, EXPIRE_NEVER, FALSE);
 }
 
@@ -785,6 +804,8 @@ NTSTATUS WINAPI RtlCreateTimerQueue(PHANDLE NewTimerQueue)
 
     RtlInitializeCriticalSection(&q->cs);
     list_init(&q->timers);
+    rb_init(&q->expire_tree, compare_queue_timers);
+    q->timer_seq = 0;
     q->quit = FALSE;
     q->magic = TIMER_QUEUE_MAGIC;
     status = NtCreateEvent(&q->event, EVENT_ALL_ACCESS, NULL, SynchronizationEvent, FALSE);
@@ -947,6 +968,7 @@ NTSTATUS WINAPI RtlCreateTimer(HANDLE TimerQueue, HANDLE *NewTimer,
     else
     {
         *NewTimer = t;
+        list_add_tail(&q->timers, &t->entry);
         queue_add_timer(t, queue_current_time() + DueTime, TRUE);
     }
     RtlLeaveCriticalSection(&q->cs);
@@ -1051,15 +1073,43 @@ NTSTATUS WINAPI RtlDeleteTimer(HANDLE TimerQueue, HANDLE Timer,
     return status;
 }
 
+/***********************************************************************
+ *           compare_pending_timers    (internal)
+ *
+ * Orders pending timers by timeout. Timers with the same timeout are
+ * ordered by sequence number, so that they expire in the order they were set.
+ */
+static int compare_pending_timers( const void *key, const struct rb_entry *entry )
+{
+    const struct threadpool_object *a = key;
+    const struct threadpool_object *b = RB_ENTRY_VALUE( entry, const struct threadpool_object, u.timer.timer_entry );
+
+    if (a->u.timer.timeout != b->u.timer.timeout) return a->u.timer.timeout < b->u.timer.timeout ? -1 : 1;
+    if (a->u.timer.seq != b->u.timer.seq) return a->u.timer.seq < b->u.timer.seq ? -1 : 1;
+    return 0;
+}
+
+/***********************************************************************
+ *           timerqueue_first_timer    (internal)
+ *
+ * Returns the pending timer with the earliest timeout. Must be called
+ * with timerqueue.cs held.
+ */
+static struct threadpool_object *timerqueue_first_timer(void)
+{
+    struct rb_entry *head = rb_head( timerqueue.pending_timers.root );
+    return head ? RB_ENTRY_VALUE( head, struct threadpool_object, u.timer.timer_entry ) : NULL;
+}
+
 /***********************************************************************
  *           timerqueue_thread_proc    (internal)
  */
 static void CALLBACK timerqueue_thread_proc( void *param )
 {
     ULONGLONG timeout_lower, timeout_upper, new_timeout;
-    struct threadpool_object *other_timer;
+    struct threadpool_object *timer;
     LARGE_INTEGER now, timeout;
-    struct list *ptr;
+    struct rb_entry *ptr;
 
     TRACE( "starting timer queue thread\n" );
     set_thread_name(L"wine_threadpool_timerqueue");
@@ -1070,16 +1120,15 @@ static void CALLBACK timerqueue_thread_proc( void *param )
         NtQuerySystemTime( &now );
 
         /* Check for expired timers. */
-        while ((ptr = list_head( &timerqueue.pending_timers )))
+        while ((timer = timerqueue_first_timer()))
         {
-            struct threadpool_object *timer = LIST_ENTRY( ptr, struct threadpool_object, u.timer.timer_entry );
             assert( timer->type == TP_OBJECT_TYPE_TIMER );
             assert( timer->u.timer.timer_pending );
             if (timer->u.timer.timeout > now.QuadPart)
                 break;
 
             /* Queue a new callback in one of the worker threads. */
-            list_remove( &timer->u.timer.timer_entry );
+            rb_remove( &timerqueue.pending_timers, &timer->u.timer.timer_entry );
             timer->u.timer.timer_pending = FALSE;
             tp_object_submit( timer, FALSE );
 
@@ -1090,30 +1139,25 @@ static void CALLBACK timerqueue_thread_proc( void *param )
                 if (timer->u.timer.timeout <= now.QuadPart)
                     timer->u.timer.timeout = now.QuadPart + 1;
 
-                LIST_FOR_EACH_ENTRY( other_timer, &timerqueue.pending_timers,
-                                     struct threadpool_object, u.timer.timer_entry )
-                {
-                    assert( other_timer->type == TP_OBJECT_TYPE_TIMER );
-                    if (timer->u.timer.timeout < other_timer->u.timer.timeout)
-                        break;
-                }
-                list_add_before( &other_timer->u.timer.timer_entry, &timer->u.timer.timer_entry );
+                timer->u.timer.seq = ++timerqueue.timer_seq;
+                rb_put( &timerqueue.pending_timers, timer, &timer->u.timer.timer_entry );
                 timer->u.timer.timer_pending = TRUE;
             }
         }
 
         timeout_lower = timeout_upper = MAXLONGLONG;
 
-        /* Determine next timeout and use the window length to optimize wakeup times. */
-        LIST_FOR_EACH_ENTRY( other_timer, &timerqueue.pending_timers,
-                             struct threadpool_object, u.timer.timer_entry )
+        /* Determine next timeout and use the window length to optimize wakeup times.
+         * Only the timers which are due before the earliest window closes are visited. */
+        for (ptr = rb_head( timerqueue.pending_timers.root ); ptr; ptr = rb_next( ptr ))
         {
-            assert( other_timer->type == TP_OBJECT_TYPE_TIMER );
-            if (other_timer->u.timer.timeout >= timeout_upper)
+            timer = RB_ENTRY_VALUE( ptr, struct threadpool_object, u.timer.timer_entry );
+            assert( timer->type == TP_OBJECT_TYPE_TIMER );
+            if (timer->u.timer.timeout >= timeout_upper)
                 break;
 
-            timeout_lower = other_timer->u.timer.timeout;
-            new_timeout   = timeout_lower + (ULONGLONG)other_timer->u.timer.window_length * 10000;
+            timeout_lower = timer->u.timer.timeout;
+            new_timeout   = timeout_lower + (ULONGLONG)timer->u.timer.window_length * 10000;
             if (new_timeout < timeout_upper)
                 timeout_upper = new_timeout;
         }
@@ -1222,14 +1266,14 @@ static void tp_timerqueue_unlock( struct threadpool_object *timer )
         /* If timer was pending, remove it. */
         if (timer->u.timer.timer_pending)
         {
-            list_remove( &timer->u.timer.timer_entry );
+            rb_remove( &timerqueue.pending_timers, &timer->u.timer.timer_entry );
             timer->u.timer.timer_pending = FALSE;
         }
 
         /* If the last timer object was destroyed, then wake up the thread. */
         if (!--timerqueue.objcount)
         {
-            assert( list_empty( &timerqueue.pending_timers ) );
+            assert( !timerqueue.pending_timers.root );
             RtlWakeAllConditionVariable( &timerqueue.update_event );
         }
 
@@ -1432,14 +1476,22 @@ static NTSTATUS tp_waitqueue_lock( struct threadpool_object *wait )
 
     RtlEnterCriticalSection( &waitqueue.cs );
 
-    /* Try to assign to existing bucket if possible. */
+    /* Try to assign to existing bucket if possible. Full buckets are moved to
+     * the end of the list, so there is no need to look past the first one. */
     LIST_FOR_EACH_ENTRY( bucket, &waitqueue.buckets, struct waitqueue_bucket, bucket_entry )
     {
-        if (bucket->objcount < MAXIMUM_WAITQUEUE_OBJECTS && bucket->alertable == alertable)
+        if (bucket->objcount >= MAXIMUM_WAITQUEUE_OBJECTS)
+            break;
+
+        if (bucket->alertable == alertable)
         {
             list_add_tail( &bucket->reserved, &wait->u.wait.wait_entry );
             wait->u.wait.bucket = bucket;
-            bucket->objcount++;
+            if (++bucket->objcount == MAXIMUM_WAITQUEUE_OBJECTS)
+            {
+                list_remove( &bucket->bucket_entry );
+                list_add_tail( &waitqueue.buckets, &bucket->bucket_entry );
+            }
 
             status = STATUS_SUCCESS;
             goto out;
@@ -1471,7 +1523,7 @@ static NTSTATUS tp_waitqueue_lock( struct threadpool_object *wait )
                                   waitqueue_thread_proc, bucket, &thread, NULL );
     if (status == STATUS_SUCCESS)
     {
-        list_add_tail( &waitqueue.buckets, &bucket->bucket_entry );
+        list_add_head( &waitqueue.buckets, &bucket->bucket_entry );
         waitqueue.num_buckets++;
 
         list_add_tail( &bucket->reserved, &wait->u.wait.wait_entry );
@@ -1506,7 +1558,12 @@ static void tp_waitqueue_unlock( struct threadpool_object *wait )
 
         list_remove( &wait->u.wait.wait_entry );
         wait->u.wait.bucket = NULL;
-        bucket->objcount--;
+        if (bucket->objcount-- == MAXIMUM_WAITQUEUE_OBJECTS)
+        {
+            /* The bucket has a free slot again, make it available for new wait objects. */
+            list_remove( &bucket->bucket_entry );
+            list_add_head( &waitqueue.buckets, &bucket->bucket_entry );
+        }
 
         NtSetEvent( bucket->update_event, NULL );
     }
@@ -1974,6 +2031,34 @@ static void tp_object_prio_queue( struct threadpool_object *object )
     list_add_tail( &object->pool->pools[object->priority], &object->pool_entry );
 }
 
+/***********************************************************************
+ *           tp_start_worker_thread    (internal)
+ *
+ * Create a worker thread which was already accounted for with pool->cs
+ * held. Must be called without holding pool->cs, so that the expensive
+ * thread creation doesn't block other threads submitting work.
+ */
+static NTSTATUS tp_start_worker_thread( struct threadpool *pool )
+{
+    HANDLE thread;
+    NTSTATUS status;
+
+    status = RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE, 0, 0, 0,
+                                  threadpool_worker_proc, pool, &thread, NULL );
+    if (status == STATUS_SUCCESS)
+    {
+        NtClose( thread );
+        return STATUS_SUCCESS;
+    }
+
+    RtlEnterCriticalSection( &pool->cs );
+    pool->num_workers--;
+    assert( pool->num_workers > 0 );
+    RtlLeaveCriticalSection( &pool->cs );
+    tp_threadpool_release( pool );
+    return status;
+}
+
 /***********************************************************************
  *           tp_object_submit    (internal)
  *
@@ -1983,17 +2068,22 @@ static void tp_object_prio_queue( struct threadpool_object *object )
 static void tp_object_submit( struct threadpool_object *object, BOOL signaled )
 {
     struct threadpool *pool = object->pool;
-    NTSTATUS status = STATUS_UNSUCCESSFUL;
+    BOOL new_worker = FALSE;
 
     assert( !object->shutdown );
     assert( !pool->shutdown );
 
     RtlEnterCriticalSection( &pool->cs );
 
-    /* Start new worker threads if required. */
+    /* Account for a new worker thread if required, the thread itself is
+     * created after leaving the critical section. */
     if (pool->num_busy_workers >= pool->num_workers &&
         pool->num_workers < pool->max_workers)
-        status = tp_new_worker_thread( pool );
+    {
+        InterlockedIncrement( &pool->refcount );
+        pool->num_workers++;
+        new_worker = TRUE;
+    }
 
     /* Queue work item and increment refcount. */
     InterlockedIncrement( &object->refcount );
@@ -2004,14 +2094,16 @@ static void tp_object_submit( struct threadpool_object *object, BOOL signaled )
     if (object->type == TP_OBJECT_TYPE_WAIT && signaled)
         object->u.wait.signaled++;
 
-    /* No new thread started - wake up one existing thread. */
-    if (status != STATUS_SUCCESS)
-    {
-        assert( pool->num_workers > 0 );
-        RtlWakeConditionVariable( &pool->update_event );
-    }
-
+    assert( pool->num_workers > 0 );
     RtlLeaveCriticalSection( &pool->cs );
+
+    if (new_worker && tp_start_worker_thread( pool ) == STATUS_SUCCESS)
+        return;
+
+    /* No new thread started - wake up one existing thread. Doing this after
+     * leaving the critical section avoids waking a thread which would
+     * immediately block on pool->cs again. */
+    RtlWakeConditionVariable( &pool->update_event );
 }
 
 /***********************************************************************
@@ -2970,7 +3062,6 @@ BOOL WINAPI TpSetPoolMinThreads( TP_POOL *pool, DWORD minimum )
 VOID WINAPI TpSetTimer( TP_TIMER *timer, LARGE_INTEGER *timeout, LONG period, LONG window_length )
 {
     struct threadpool_object *this = impl_from_TP_TIMER( timer );
-    struct threadpool_object *other_timer;
     BOOL submit_timer = FALSE;
     ULONGLONG timestamp;
 
@@ -3009,7 +3100,7 @@ VOID WINAPI TpSetTimer( TP_TIMER *timer, LARGE_INTEGER *timeout, LONG period, LO
     /* First remove existing timeout. */
     if (this->u.timer.timer_pending)
     {
-        list_remove( &this->u.timer.timer_entry );
+        rb_remove( &timerqueue.pending_timers, &this->u.timer.timer_entry );
         this->u.timer.timer_pending = FALSE;
     }
 
@@ -3019,18 +3110,12 @@ VOID WINAPI TpSetTimer( TP_TIMER *timer, LARGE_INTEGER *timeout, LONG period, LO
         this->u.timer.timeout       = timestamp;
         this->u.timer.period        = period;
         this->u.timer.window_length = window_length;
+        this->u.timer.seq           = ++timerqueue.timer_seq;
 
-        LIST_FOR_EACH_ENTRY( other_timer, &timerqueue.pending_timers,
-                             struct threadpool_object, u.timer.timer_entry )
-        {
-            assert( other_timer->type == TP_OBJECT_TYPE_TIMER );
-            if (this->u.timer.timeout < other_timer->u.timer.timeout)
-                break;
-        }
-        list_add_before( &other_timer->u.timer.timer_entry, &this->u.timer.timer_entry );
+        rb_put( &timerqueue.pending_timers, this, &this->u.timer.timer_entry );
 
         /* Wake up the timer thread when the timeout has to be updated. */
-        if (list_head( &timerqueue.pending_timers ) == &this->u.timer.timer_entry )
+        if (timerqueue_first_timer() == this)
             RtlWakeAllConditionVariable( &timerqueue.update_event );
 
         this->u.timer.timer_pending = TRUE;
@@ -2731,6 +2731,234 @@ NTSTATUS WINAPI NtQueryDirectoryFile( HANDLE handle, HANDLE event, PIO_APC_ROUTI
 }
 
 
+/* case-insensitive index of the names of a directory, used to speed up find_file_in_dir */
+struct dir_index_entry
+{
+    unsigned int hash;   /* hash of the upper-case name */
+    unsigned int next;   /* next entry in the same bucket */
+    unsigned int name;   /* offset of the unix name in the names buffer */
+};
+
+struct dir_index
+{
+    struct list             entry;      /* entry in dir_indexes list */
+    dev_t                   dev;        /* directory identity */
+    ino_t                   ino;
+    ULONGLONG               mtime;      /* directory modification time when the index was built */
+    unsigned int            count;      /* number of entries */
+    unsigned int            size;       /* size of the entries array */
+    unsigned int            names_pos;  /* used size of the names buffer */
+    unsigned int            names_size; /* allocated size of the names buffer */
+    unsigned int            mask;       /* buckets count - 1 */
+    unsigned int           *buckets;    /* NULL if the directory is large but not indexed yet */
+    struct dir_index_entry *entries;
+    char                   *names;
+};
+
+#define DIR_INDEX_NONE        (~0u)
+#define DIR_INDEX_MIN_ENTRIES 256  /* don't index directories smaller than this */
+#define DIR_INDEX_MAX_DIRS    16
+
+static struct list dir_indexes = LIST_INIT( dir_indexes );
+static unsigned int dir_indexes_count;
+static pthread_mutex_t dir_index_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static inline ULONGLONG get_dir_mtime( const struct stat *st )
+{
+    ULONGLONG mtime = (ULONGLONG)st->st_mtime * 1000000000;
+#ifdef HAVE_STRUCT_STAT_ST_MTIM
+    mtime += st->st_mtim.tv_nsec;
+#elif defined(HAVE_STRUCT_STAT_ST_MTIMESPEC)
+    mtime += st->st_mtimespec.tv_nsec;
+#endif
+    return mtime;
+}
+
+static unsigned int hash_dir_entry_name( const WCHAR *name, int length )
+{
+    unsigned int i, hash = 2166136261u;
+
+    for (i = 0; i < length; i++) hash = (hash ^ towupper( name[i] )) * 16777619;
+    return hash;
+}
+
+static void free_dir_index_entries( struct dir_index *index )
+{
+    free( index->buckets );
+    free( index->entries );
+    free( index->names );
+    index->buckets = NULL;
+    index->entries = NULL;
+    index->names = NULL;
+}
+
+static void free_dir_index( struct dir_index *index )
+{
+    free_dir_index_entries( index );
+    free( index );
+}
+
+static struct dir_index *alloc_dir_index( const struct stat *st )
+{
+    struct dir_index *index;
+
+    if (!(index = calloc( 1, sizeof(*index) ))) return NULL;
+    index->dev = st->st_dev;
+    index->ino = st->st_ino;
+    index->mtime = get_dir_mtime( st );
+    return index;
+}
+
+
+/***********************************************************************
+ *           add_dir_index_entry
+ *
+ * Add a directory entry to an index being built.
+ */
+static BOOL add_dir_index_entry( struct dir_index *index, const char *unix_name, const WCHAR *name, int length )
+{
+    unsigned int len = strlen( unix_name ) + 1;
+
+    if (index->count == index->size)
+    {
+        unsigned int size = max( 64, index->size * 2 );
+        struct dir_index_entry *new_entries;
+
+        if (!(new_entries = realloc( index->entries, size * sizeof(*new_entries) ))) return FALSE;
+        index->entries = new_entries;
+        index->size = size;
+    }
+    if (index->names_pos + len > index->names_size)
+    {
+        unsigned int size = max( max( 4096, index->names_size * 2 ), index->names_pos + len );
+        char *new_names;
+
+        if (!(new_names = realloc( index->names, size ))) return FALSE;
+        index->names = new_names;
+        index->names_size = size;
+    }
+    index->entries[index->count].hash = hash_dir_entry_name( name, length );
+    index->entries[index->count].name = index->names_pos;
+    memcpy( index->names + index->names_pos, unix_name, len );
+    index->names_pos += len;
+    index->count++;
+    return TRUE;
+}
+
+
+/***********************************************************************
+ *           cache_dir_index
+ *
+ * Add the index of a directory to the cache, or only remember that the directory
+ * is large if index is a placeholder without entries. Takes ownership of index.
+ */
+static void cache_dir_index( struct dir_index *index )
+{
+    struct dir_index *old;
+    unsigned int i, size;
+
+    if (index->entries)
+    {
+        for (size = 16; size < index->count; size *= 2) ;
+        if ((index->buckets = malloc( size * sizeof(*index->buckets) )))
+        {
+            index->mask = size - 1;
+            for (i = 0; i < size; i++) index->buckets[i] = DIR_INDEX_NONE;
+            for (i = index->count; i--; )  /* keep the readdir order in each bucket */
+            {
+                unsigned int bucket = index->entries[i].hash & index->mask;
+                index->entries[i].next = index->buckets[bucket];
+                index->buckets[bucket] = i;
+            }
+        }
+        /* don't keep the entries of directories that have been modified too recently
+         * for their modification time to reliably change on the next update */
+        if (!index->buckets || index->mtime / 1000000000 >= time( NULL ) - 1)
+            free_dir_index_entries( index );
+    }
+
+    mutex_lock( &dir_index_mutex );
+
+    LIST_FOR_EACH_ENTRY( old, &dir_indexes, struct dir_index, entry )
+    {
+        if (old->dev != index->dev || old->ino != index->ino) continue;
+        list_remove( &old->entry );
+        free_dir_index( old );
+        dir_indexes_count--;
+        break;
+    }
+
+    dir_indexes_count++;
+    list_add_head( &dir_indexes, &index->entry );
+    if (dir_indexes_count > DIR_INDEX_MAX_DIRS)
+    {
+        struct dir_index *last = LIST_ENTRY( list_tail( &dir_indexes ), struct dir_index, entry );
+        list_remove( &last->entry );
+        free_dir_index( last );
+        dir_indexes_count--;
+    }
+
+    mutex_unlock( &dir_index_mutex );
+}
+
+
+/***********************************************************************
+ *           find_file_in_dir_index
+ *
+ * Look for a file in the cached case-insensitive index of a directory.
+ * The file found is appended to unix_name at pos.
+ * Returns STATUS_NOT_SUPPORTED if the directory isn't indexed, and sets build
+ * if it is known to be large enough to be indexed.
+ */
+static NTSTATUS find_file_in_dir_index( char *unix_name, int pos, const WCHAR *name, int length,
+                                        const struct stat *st, BOOL *build )
+{
+    WCHAR buffer[MAX_DIR_ENTRY_LEN];
+    struct dir_index *index;
+    NTSTATUS status = STATUS_NOT_SUPPORTED;
+    unsigned int i, hash;
+    int ret;
+
+    *build = FALSE;
+
+    mutex_lock( &dir_index_mutex );
+
+    LIST_FOR_EACH_ENTRY( index, &dir_indexes, struct dir_index, entry )
+    {
+        if (index->dev != st->st_dev || index->ino != st->st_ino) continue;
+        if (!index->buckets || index->mtime != get_dir_mtime( st ))
+        {
+            *build = TRUE;
+            break;
+        }
+
+        list_remove( &index->entry );
+        list_add_head( &dir_indexes, &index->entry );
+
+        status = STATUS_OBJECT_NAME_NOT_FOUND;
+        hash = hash_dir_entry_name( name, length );
+        for (i = index->buckets[hash & index->mask]; i != DIR_INDEX_NONE; i = index->entries[i].next)
+        {
+            const char *unix_entry = index->names + index->entries[i].name;
+
+            if (index->entries[i].hash != hash) continue;
+            ret = ntdll_umbstowcs( unix_entry, strlen(unix_entry), buffer, MAX_DIR_ENTRY_LEN );
+            if (ret == length && !wcsnicmp( buffer, name, ret ))
+            {
+                unix_name[pos - 1] = '/';
+                strcpy( unix_name + pos, unix_entry );
+                status = STATUS_SUCCESS;
+                break;
+            }
+        }
+        break;
+    }
+
+    mutex_unlock( &dir_index_mutex );
+    return status;
+}
+
+
 /***********************************************************************
  *           find_file_in_dir
  *
@@ -2743,9 +2971,13 @@ static NTSTATUS find_file_in_dir( char *unix_name, int pos, const WCHAR *name, i
 {
     WCHAR buffer[MAX_DIR_ENTRY_LEN];
     BOOLEAN is_name_8_dot_3;
+    NTSTATUS status;
     DIR *dir;
     struct dirent *de;
+    struct dir_index *index = NULL;
     struct stat st;
+    unsigned int count = 0;
+    BOOL build_index, found = FALSE;
     int ret;
 
     /* try a shortcut for this directory */
@@ -2821,35 +3053,51 @@ static NTSTATUS find_file_in_dir( char *unix_name, int pos, const WCHAR *name, i
     }
 #endif /* VFAT_IOCTL_READDIR_BOTH */
 
+    if (stat( unix_name, &st ) == -1) return errno_to_status( errno );
+
+    status = find_file_in_dir_index( unix_name, pos, name, length, &st, &build_index );
+    if (status == STATUS_SUCCESS) return status;
+    /* the index only contains long names, so short names still need a full scan */
+    if (status == STATUS_OBJECT_NAME_NOT_FOUND && !is_name_8_dot_3) goto not_found;
+
     if (!(dir = opendir( unix_name ))) return errno_to_status( errno );
 
+    /* the index of a directory known to be large is built while searching it */
+    if (build_index) index = alloc_dir_index( &st );
+
     unix_name[pos - 1] = '/';
     while ((de = readdir( dir )))
     {
         ret = ntdll_umbstowcs( de->d_name, strlen(de->d_name), buffer, MAX_DIR_ENTRY_LEN );
-        if (ret == length && !wcsnicmp( buffer, name, ret ))
+        count++;
+
+        if (index && !add_dir_index_entry( index, de->d_name, buffer, ret ))
         {
-            strcpy( unix_name + pos, de->d_name );
-            closedir( dir );
-            return STATUS_SUCCESS;
+            free_dir_index( index );
+            index = NULL;
         }
 
-        if (!is_name_8_dot_3) continue;
-
-        if (!is_legal_8dot3_name( buffer, ret ))
+        if (!found)
         {
-            WCHAR short_nameW[12];
-            ret = hash_short_file_name( buffer, ret, short_nameW );
-            if (ret == length && !wcsnicmp( short_nameW, name, length ))
+            if (ret == length && !wcsnicmp( buffer, name, ret )) found = TRUE;
+            else if (is_name_8_dot_3 && !is_legal_8dot3_name( buffer, ret ))
             {
-                strcpy( unix_name + pos, de->d_name );
-                closedir( dir );
-                return STATUS_SUCCESS;
+                WCHAR short_nameW[12];
+                ret = hash_short_file_name( buffer, ret, short_nameW );
+                found = ret == length && !wcsnicmp( short_nameW, name, length );
             }
+            if (found) strcpy( unix_name + pos, de->d_name );
         }
+        if (found && !index) break;
     }
     closedir( dir );
 
+    if (index) cache_dir_index( index );
+    else if (status == STATUS_NOT_SUPPORTED && !build_index && count >= DIR_INDEX_MIN_ENTRIES &&
+             (index = alloc_dir_index( &st )))
+        cache_dir_index( index );
+    if (found) return STATUS_SUCCESS;
+
 not_found:
     unix_name[pos - 1] = 0;
     return STATUS_OBJECT_NAME_NOT_FOUND;
@@ -3386,6 +3634,123 @@ done:
 }
 
 
+/* cache of resolved parent directories, used to skip the component walk in lookup_unix_name */
+struct dir_cache_entry
+{
+    unsigned int hash;      /* hash of the unix base and of the upper-case NT path */
+    int          base_len;  /* length of the unix base directory */
+    int          name_len;  /* length of the NT path relative to the base */
+    size_t       size;      /* allocated size of the name buffer */
+    WCHAR       *name;      /* NT path relative to the base */
+    char        *unix_name; /* resolved unix path, starting with the base */
+};
+
+#define DIR_CACHE_SIZE 256
+
+static struct dir_cache_entry dir_cache[DIR_CACHE_SIZE];
+static LONG dir_cache_hits, dir_cache_misses;
+static pthread_mutex_t dir_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static unsigned int hash_dir_cache_key( const char *base, int base_len, const WCHAR *name, int name_len )
+{
+    unsigned int i, hash = 2166136261u;
+
+    for (i = 0; i < base_len; i++) hash = (hash ^ (unsigned char)base[i]) * 16777619;
+    for (i = 0; i < name_len; i++) hash = (hash ^ towupper( name[i] )) * 16777619;
+    return hash;
+}
+
+static inline BOOL dir_cache_entry_matches( const struct dir_cache_entry *entry, unsigned int hash,
+                                            const char *base, int base_len, const WCHAR *name, int name_len )
+{
+    return entry->unix_name && entry->hash == hash &&
+           entry->base_len == base_len && entry->name_len == name_len &&
+           !memcmp( entry->unix_name, base, base_len ) && !wcsnicmp( entry->name, name, name_len );
+}
+
+
+/***********************************************************************
+ *           get_cached_dir
+ *
+ * Replace the unix base directory at the start of the buffer by the cached resolution of
+ * the NT directory path name relative to it. Returns the new length, or 0 if not found.
+ */
+static int get_cached_dir( char **buffer, int *unix_len, int base_len, const WCHAR *name, int name_len )
+{
+    unsigned int hash = hash_dir_cache_key( *buffer, base_len, name, name_len );
+    struct dir_cache_entry *entry = &dir_cache[hash % DIR_CACHE_SIZE];
+    int len = 0;
+    struct stat st;
+
+    mutex_lock( &dir_cache_mutex );
+    if (dir_cache_entry_matches( entry, hash, *buffer, base_len, name, name_len ))
+    {
+        len = strlen( entry->unix_name );
+        if (*unix_len < len + MAX_DIR_ENTRY_LEN + 3)
+        {
+            char *new_name;
+            if ((new_name = realloc( *buffer, len + 2 * MAX_DIR_ENTRY_LEN + 3 )))
+            {
+                *buffer = new_name;
+                *unix_len = len + 2 * MAX_DIR_ENTRY_LEN + 3;
+            }
+            else len = 0;
+        }
+        if (len) strcpy( *buffer, entry->unix_name );
+    }
+    mutex_unlock( &dir_cache_mutex );
+
+    /* make sure that the directory still exists */
+    if (len && (stat( *buffer, &st ) || !S_ISDIR( st.st_mode )))
+    {
+        (*buffer)[base_len] = 0;
+        len = 0;
+    }
+
+    InterlockedIncrement( len ? &dir_cache_hits : &dir_cache_misses );
+    return len;
+}
+
+
+/***********************************************************************
+ *           add_cached_dir
+ *
+ * Cache the resolution of a NT directory path relative to a unix base directory.
+ */
+static void add_cached_dir( const char *unix_name, int unix_name_len, int base_len,
+                            const WCHAR *name, int name_len )
+{
+    unsigned int hash = hash_dir_cache_key( unix_name, base_len, name, name_len );
+    struct dir_cache_entry *entry = &dir_cache[hash % DIR_CACHE_SIZE];
+    size_t size = name_len * sizeof(WCHAR) + unix_name_len + 1;
+
+    mutex_lock( &dir_cache_mutex );
+    if (entry->size < size)
+    {
+        WCHAR *nameW;
+
+        if (!(nameW = realloc( entry->name, size )))
+        {
+            mutex_unlock( &dir_cache_mutex );
+            return;
+        }
+        entry->name = nameW;
+        entry->size = size;
+    }
+    entry->hash      = hash;
+    entry->base_len  = base_len;
+    entry->name_len  = name_len;
+    entry->unix_name = (char *)(entry->name + name_len);
+    memcpy( entry->name, name, name_len * sizeof(WCHAR) );
+    memcpy( entry->unix_name, unix_name, unix_name_len );
+    entry->unix_name[unix_name_len] = 0;
+    mutex_unlock( &dir_cache_mutex );
+
+    TRACE( "cached %s, %d hits, %d misses\n", debugstr_an(unix_name, unix_name_len),
+           (int)dir_cache_hits, (int)dir_cache_misses );
+}
+
+
 /******************************************************************************
  *           lookup_unix_name
  *
@@ -3396,10 +3761,11 @@ static NTSTATUS lookup_unix_name( const WCHAR *name, int name_len, char **buffer
 {
     static const WCHAR invalid_charsW[] = { INVALID_NT_CHARS, '/', 0 };
     NTSTATUS status;
-    int ret;
+    int ret, base_len, dir_len, dir_pos = 0;
     struct stat st;
     char *unix_name = *buffer;
-    const WCHAR *ptr, *end;
+    const WCHAR *ptr, *end, *dir_name;
+    BOOL use_cache;
 
     /* check syntax of individual components */
 
@@ -3458,6 +3824,27 @@ static NTSTATUS lookup_unix_name( const WCHAR *name, int name_len, char **buffer
     if (skip_search && strcasestr(unix_name, skip_search) && disposition == FILE_OPEN)
         return STATUS_OBJECT_NAME_NOT_FOUND;
 
+    /* skip the parent directory components if they have already been resolved */
+    /* a relative base is the current directory of a RootDirectory lookup, it can't be cached */
+
+    unix_name[pos] = 0;
+    dir_name = name;
+    base_len = pos;
+    for (dir_len = name_len - 1; dir_len > 0; dir_len--) if (name[dir_len - 1] == '\\') break;
+    use_cache = --dir_len > 0 && !is_unix && unix_name[0] == '/';
+    if (use_cache)
+    {
+        if ((ret = get_cached_dir( buffer, &unix_len, pos, name, dir_len )))
+        {
+            unix_name = *buffer;
+            pos = ret;
+            name += dir_len + 1;
+            name_len -= dir_len + 1;
+            dir_len = 0;
+        }
+        else unix_name = *buffer;
+    }
+
     /* now do it component by component */
 
     while (name_len)
@@ -3470,6 +3857,8 @@ static NTSTATUS lookup_unix_name( const WCHAR *name, int name_len, char **buffer
         if (next < name + name_len) next++;
         name_len -= next - name;
 
+        if (!name_len) dir_pos = pos;
+
         /* grow the buffer if needed */
 
         if (unix_len - pos < MAX_DIR_ENTRY_LEN + 3)
@@ -3515,6 +3904,10 @@ static NTSTATUS lookup_unix_name( const WCHAR *name, int name_len, char **buffer
         name = next;
     }
 
+    /* only cache the parent directory if the lookup went through it */
+    if ((status == STATUS_SUCCESS || status == STATUS_NO_SUCH_FILE) && dir_len > 0 && use_cache)
+        add_cached_dir( unix_name, dir_pos, base_len, dir_name, dir_len );
+
     return status;
 }
 
@@ -1426,6 +1426,7 @@ static void server_set_msgwait( int in_msgwait )
 NTSTATUS fsync_wait_objects( DWORD count, const HANDLE *handles, BOOLEAN wait_any,
                              BOOLEAN alertable, const LARGE_INTEGER *timeout )
 {
+    static const LARGE_INTEGER zero = {0};
     BOOL msgwait = FALSE;
     struct fsync obj;
     NTSTATUS ret;
@@ -1433,13 +1434,22 @@ NTSTATUS fsync_wait_objects( DWORD count, const HANDLE *handles, BOOLEAN wait_an
     if (count && !get_object( handles[count - 1], &obj ))
     {
         if (obj.type == FSYNC_QUEUE)
-        {
             msgwait = TRUE;
-            server_set_msgwait( 1 );
-        }
         put_object( &obj );
     }
 
+    /* If the wait can be satisfied right away, the thread never blocks on its
+     * queue, so there is no need to tell the server about it. Zero timeout
+     * waits still go through the server, so that they mark the process idle. */
+    if (msgwait && (!timeout || timeout->QuadPart))
+    {
+        ret = __fsync_wait_objects( count, handles, wait_any, alertable, &zero );
+        if (ret != STATUS_TIMEOUT) return ret;
+    }
+
+    if (msgwait)
+        server_set_msgwait( 1 );
+
     ret = __fsync_wait_objects( count, handles, wait_any, alertable, timeout );
 
     if (msgwait)
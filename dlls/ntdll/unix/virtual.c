@@ -36,6 +36,14 @@
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/mman.h>
+#include <sys/ioctl.h>
+#ifdef HAVE_SYS_SYSCALL_H
+# include <sys/syscall.h>
+#endif
+#if defined(HAVE_LINUX_USERFAULTFD_H) && defined(HAVE_LINUX_FS_H)
+# include <linux/userfaultfd.h>
+# include <linux/fs.h>
+#endif
 #ifdef HAVE_SYS_SYSINFO_H
 # include <sys/sysinfo.h>
 #endif
@@ -159,6 +167,10 @@ static pthread_mutex_t virtual_mutex;
 static const UINT page_shift = 12;
 static const UINT_PTR page_mask = 0xfff;
 static const UINT_PTR granularity_mask = 0xffff;
+static const UINT_PTR large_page_mask = 0x1fffff;  /* must match GetLargePageMinimum() */
+
+/* minimum size of reservations to back with transparent huge pages, 0 to disable */
+static SIZE_T hugepage_threshold;
 
 /* Note: these are Windows limits, you cannot change them. */
 #ifdef __i386__
@@ -218,6 +230,16 @@ static int pagemap_fd, pagemap_reset_fd, clear_refs_fd;
 #define PAGE_FLAGS_BUFFER_LENGTH 1024
 #define PM_SOFT_DIRTY_PAGE (1ull << 57)
 
+#if defined(__NR_userfaultfd) && defined(UFFD_FEATURE_WP_ASYNC) && defined(PAGEMAP_SCAN)
+/* write watches can also be implemented with asynchronous userfaultfd write protection,
+ * tracked pages are then queried and protected again with the PAGEMAP_SCAN ioctl (Linux 6.7) */
+#define HAVE_UFFD_WRITE_WATCH
+#endif
+
+static BOOL disable_kernel_writewatch;
+static int uffd_fd = -1;
+
+static void register_write_watches( void *base, SIZE_T size );
 static void reset_write_watches( void *base, SIZE_T size );
 
 static struct file_view *view_block_start, *view_block_end, *next_free_view;
@@ -232,12 +254,14 @@ static BOOL force_exec_prot;  /* whether to force PROT_EXEC on all PROT_READ mma
 
 struct range_entry
 {
+    struct wine_rb_entry entry;
     void *base;
     void *end;
 };
 
-static struct range_entry *free_ranges;
-static struct range_entry *free_ranges_end;
+/* free address ranges, sorted by base address */
+static struct wine_rb_tree free_ranges;
+static struct range_entry *range_block_start, *range_block_end, *next_free_range;
 
 
 static inline BOOL is_beyond_limit( const void *addr, size_t size, const void *limit )
@@ -730,33 +754,109 @@ NTSTATUS load_builtin_unixlib( void *module, const char *name )
 }
 
 
+/***********************************************************************
+ *           compare_range
+ */
+static int compare_range( const void *addr, const struct wine_rb_entry *entry )
+{
+    struct range_entry *range = WINE_RB_ENTRY_VALUE( entry, struct range_entry, entry );
+
+    if (addr < range->base) return -1;
+    if (addr > range->base) return 1;
+    return 0;
+}
+
+static inline struct range_entry *free_ranges_first(void)
+{
+    struct wine_rb_entry *entry = rb_head( free_ranges.root );
+    return entry ? WINE_RB_ENTRY_VALUE( entry, struct range_entry, entry ) : NULL;
+}
+
+static inline struct range_entry *free_ranges_last(void)
+{
+    struct wine_rb_entry *entry = rb_tail( free_ranges.root );
+    return entry ? WINE_RB_ENTRY_VALUE( entry, struct range_entry, entry ) : NULL;
+}
+
+static inline struct range_entry *free_ranges_next( struct range_entry *range )
+{
+    struct wine_rb_entry *entry = rb_next( &range->entry );
+    return entry ? WINE_RB_ENTRY_VALUE( entry, struct range_entry, entry ) : NULL;
+}
+
+static inline struct range_entry *free_ranges_prev( struct range_entry *range )
+{
+    struct wine_rb_entry *entry = rb_prev( &range->entry );
+    return entry ? WINE_RB_ENTRY_VALUE( entry, struct range_entry, entry ) : NULL;
+}
+
+/***********************************************************************
+ *           free_ranges_add
+ *
+ * Allocates a new free range entry and inserts it in the tree.
+ */
+static void free_ranges_add( void *base, void *end )
+{
+    struct range_entry *range;
+
+    if ((range = next_free_range))
+        next_free_range = *(struct range_entry **)range;
+    else
+    {
+        if (range_block_start == range_block_end)
+            ERR( "Free range sequence is full, trouble ahead!\n" );
+        assert( range_block_start < range_block_end );
+        range = range_block_start++;
+    }
+
+    range->base = base;
+    range->end = end;
+    wine_rb_put( &free_ranges, base, &range->entry );
+}
+
+/***********************************************************************
+ *           free_ranges_del
+ *
+ * Removes a free range entry from the tree and releases it.
+ */
+static void free_ranges_del( struct range_entry *range )
+{
+    wine_rb_remove( &free_ranges, &range->entry );
+    assert( free_ranges.root );
+
+    *(struct range_entry **)range = next_free_range;
+    next_free_range = range;
+}
+
 /***********************************************************************
  *           free_ranges_lower_bound
  *
- * Returns the first range whose end is not less than addr, or end if there's none.
+ * Returns the first range whose end is not less than addr, or NULL if there's none.
  */
 static struct range_entry *free_ranges_lower_bound( void *addr )
 {
-    struct range_entry *begin = free_ranges;
-    struct range_entry *end = free_ranges_end;
-    struct range_entry *mid;
+    struct wine_rb_entry *ptr = free_ranges.root;
+    struct range_entry *range, *ret = NULL;
 
-    while (begin < end)
+    while (ptr)
     {
-        mid = begin + (end - begin) / 2;
-        if (mid->end < addr)
-            begin = mid + 1;
+        range = WINE_RB_ENTRY_VALUE( ptr, struct range_entry, entry );
+        if (range->end < addr)
+            ptr = ptr->right;
         else
-            end = mid;
+        {
+            ret = range;
+            ptr = ptr->left;
+        }
     }
 
-    return begin;
+    return ret;
 }
 
 static void dump_free_ranges(void)
 {
     struct range_entry *r;
-    for (r = free_ranges; r != free_ranges_end; ++r)
+    WINE_RB_FOR_EACH_ENTRY( r, &free_ranges, struct range_entry, entry )
         TRACE_(virtual_ranges)("%p - %p.\n", r->base, r->end);
 }
 
@@ -770,11 +870,12 @@ static void free_ranges_insert_view( struct file_view *view )
     void *view_base = ROUND_ADDR( view->base, granularity_mask );
     void *view_end = ROUND_ADDR( (char *)view->base + view->size + granularity_mask, granularity_mask );
     struct range_entry *range = free_ranges_lower_bound( view_base );
-    struct range_entry *next = range + 1;
+    struct range_entry *next;
 
     /* free_ranges initial value is such that the view is either inside range or before another one. */
-    assert( range != free_ranges_end );
-    assert( range->end > view_base || next != free_ranges_end );
+    assert( range );
+    next = free_ranges_next( range );
+    assert( range->end > view_base || next );
 
     /* Free ranges addresses are aligned at granularity_mask while the views may be not. */
 
@@ -801,15 +902,9 @@ static void free_ranges_insert_view( struct file_view *view )
     /* need to split the range in two */
     if (range->base < view_base && range->end > view_end)
     {
-        memmove( next + 1, next, (free_ranges_end - next) * sizeof(struct range_entry) );
-        free_ranges_end += 1;
-        if ((char *)free_ranges_end - (char *)free_ranges > view_block_size)
-            ERR( "Free range sequence is full, trouble ahead!\n" );
-        assert( (char *)free_ranges_end - (char *)free_ranges <= view_block_size );
-
-        next->base = view_end;
-        next->end = range->end;
+        void *end = range->end;
         range->end = view_base;
+        free_ranges_add( view_end, end );
     }
     else
     {
@@ -825,9 +920,7 @@ static void free_ranges_insert_view( struct file_view *view )
             return;
         }
         /* and possibly remove it if it's now empty */
-        memmove( range, next, (free_ranges_end - next) * sizeof(struct range_entry) );
-        free_ranges_end -= 1;
-        assert( free_ranges_end - free_ranges > 0 );
+        free_ranges_del( range );
     }
     VIRTUAL_DEBUG_DUMP_RANGES();
 }
@@ -842,7 +935,7 @@ static void free_ranges_remove_view( struct file_view *view )
     void *view_base = ROUND_ADDR( view->base, granularity_mask );
     void *view_end = ROUND_ADDR( (char *)view->base + view->size + granularity_mask, granularity_mask );
     struct range_entry *range = free_ranges_lower_bound( view_base );
-    struct range_entry *next = range + 1;
+    struct range_entry *next;
 
     /* Free ranges addresses are aligned at granularity_mask while the views may be not. */
     struct file_view *prev_view = RB_ENTRY_VALUE( rb_prev( &view->entry ), struct file_view, entry );
@@ -865,8 +958,9 @@ static void free_ranges_remove_view( struct file_view *view )
         return;
     }
     /* free_ranges initial value is such that the view is either inside range or before another one. */
-    assert( range != free_ranges_end );
-    assert( range->end > view_base || next != free_ranges_end );
+    assert( range );
+    next = free_ranges_next( range );
+    assert( range->end > view_base || next );
 
     /* this should never happen, but we can safely ignore it */
     if (range->base <= view_base && range->end >= view_end)
@@ -884,9 +978,7 @@ static void free_ranges_remove_view( struct file_view *view )
     if (range->end == view_base && next->base == view_end)
     {
         range->end = next->end;
-        memmove( next, next + 1, (free_ranges_end - next - 1) * sizeof(struct range_entry) );
-        free_ranges_end -= 1;
-        assert( free_ranges_end - free_ranges > 0 );
+        free_ranges_del( next );
     }
     /* or try growing the range */
     else if (range->end == view_base)
@@ -895,16 +987,8 @@ static void free_ranges_remove_view( struct file_view *view )
         range->base = view_base;
     /* otherwise create a new one */
     else
-    {
-        memmove( range + 1, range, (free_ranges_end - range) * sizeof(struct range_entry) );
-        free_ranges_end += 1;
-        if ((char *)free_ranges_end - (char *)free_ranges > view_block_size)
-            ERR( "Free range sequence is full, trouble ahead!\n" );
-        assert( (char *)free_ranges_end - (char *)free_ranges <= view_block_size );
+        free_ranges_add( view_base, view_end );
 
-        range->base = view_base;
-        range->end = view_end;
-    }
     VIRTUAL_DEBUG_DUMP_RANGES();
 }
 
@@ -1611,6 +1695,7 @@ static NTSTATUS create_view( struct file_view **view_ret, void *base, size_t siz
     if (vprot & VPROT_WRITEWATCH && use_kernel_writewatch)
     {
         madvise( view->base, view->size, MADV_NOHUGEPAGE );
+        register_write_watches( view->base, view->size );
         reset_write_watches( view->base, view->size );
     }
 
@@ -1789,6 +1874,124 @@ static void update_write_watches( void *base, size_t size, size_t accessed_size
 }
 
 
+/***********************************************************************
+ *           init_uffd_write_watches
+ *
+ * Use asynchronous userfaultfd write protection for write watches if the kernel supports it.
+ * Called on the first write watch allocation, before any write watch view exists.
+ */
+static void init_uffd_write_watches(void)
+{
+#ifdef HAVE_UFFD_WRITE_WATCH
+    static const UINT64 features = UFFD_FEATURE_WP_ASYNC | UFFD_FEATURE_WP_UNPOPULATED;
+    static BOOL initialized;
+    struct uffdio_api api = { .api = UFFD_API, .features = features };
+    struct pm_scan_arg arg = { .size = sizeof(arg) };
+    int fd;
+
+    if (initialized) return;
+    initialized = TRUE;
+    if (use_kernel_writewatch || disable_kernel_writewatch) return;
+
+    if ((fd = syscall( __NR_userfaultfd, O_CLOEXEC | O_NONBLOCK | UFFD_USER_MODE_ONLY )) == -1 &&
+        (fd = syscall( __NR_userfaultfd, O_CLOEXEC | O_NONBLOCK )) == -1)
+        return;
+
+    if (ioctl( fd, UFFDIO_API, &api ) == -1 || (api.features & features) != features)
+    {
+        TRACE( "userfaultfd write protection not supported\n" );
+        close( fd );
+        return;
+    }
+
+    if ((pagemap_fd = open( "/proc/self/pagemap", O_RDONLY | O_CLOEXEC )) == -1 ||
+        ioctl( pagemap_fd, PAGEMAP_SCAN, &arg ) == -1)
+    {
+        TRACE( "PAGEMAP_SCAN not supported\n" );
+        if (pagemap_fd != -1) close( pagemap_fd );
+        close( fd );
+        return;
+    }
+
+    uffd_fd = fd;
+    use_kernel_writewatch = TRUE;
+    TRACE( "using userfaultfd write watches\n" );
+#endif
+}
+
+
+/***********************************************************************
+ *           register_write_watches
+ *
+ * Register a memory range for userfaultfd write protection.
+ */
+static void register_write_watches( void *base, SIZE_T size )
+{
+#ifdef HAVE_UFFD_WRITE_WATCH
+    struct uffdio_register reg;
+
+    if (uffd_fd == -1) return;
+
+    reg.range.start = (ULONG_PTR)base;
+    reg.range.len = size;
+    reg.mode = UFFDIO_REGISTER_MODE_WP;
+    if (ioctl( uffd_fd, UFFDIO_REGISTER, &reg ) == -1)
+        ERR( "Could not register %p-%p, error %s.\n", base, (char *)base + size, strerror(errno) );
+#endif
+}
+
+
+/***********************************************************************
+ *           get_uffd_write_watches
+ *
+ * Retrieve the written pages of a range, and protect them again if reset is set.
+ */
+static NTSTATUS get_uffd_write_watches( char *base, char *end, PVOID *addresses, ULONG_PTR *count, BOOL reset )
+{
+#ifdef HAVE_UFFD_WRITE_WATCH
+    static struct page_region regions[PAGE_FLAGS_BUFFER_LENGTH];
+    struct pm_scan_arg arg;
+    ULONG_PTR pos = 0;
+    char *addr = base;
+    int i, ret;
+
+    while (pos < *count && addr < end)
+    {
+        memset( &arg, 0, sizeof(arg) );
+        arg.size = sizeof(arg);
+        arg.flags = reset ? PM_SCAN_WP_MATCHING : 0;
+        arg.start = (ULONG_PTR)addr;
+        arg.end = (ULONG_PTR)end;
+        arg.vec = (ULONG_PTR)regions;
+        arg.vec_len = ARRAY_SIZE(regions);
+        arg.max_pages = *count - pos;
+        arg.category_mask = PAGE_IS_WRITTEN;
+        arg.return_mask = PAGE_IS_WRITTEN;
+
+        if ((ret = ioctl( pagemap_fd, PAGEMAP_SCAN, &arg )) == -1)
+        {
+            ERR( "Error scanning pages, error %s.\n", strerror(errno) );
+            return STATUS_INVALID_ADDRESS;
+        }
+        for (i = 0; i < ret; ++i)
+        {
+            for (addr = (char *)(ULONG_PTR)regions[i].start; addr < (char *)(ULONG_PTR)regions[i].end; addr += page_size)
+            {
+                assert( pos < *count );
+                addresses[pos++] = addr;
+            }
+        }
+        addr = (char *)(ULONG_PTR)arg.walk_end;
+        if (ret < ARRAY_SIZE(regions)) break;
+    }
+    *count = pos;
+    return STATUS_SUCCESS;
+#else
+    return STATUS_NOT_IMPLEMENTED;
+#endif
+}
+
+
 /***********************************************************************
  *           reset_write_watches
  *
@@ -1796,6 +1999,19 @@ static void update_write_watches( void *base, size_t size, size_t accessed_size
  */
 static void reset_write_watches( void *base, SIZE_T size )
 {
+#ifdef HAVE_UFFD_WRITE_WATCH
+    if (uffd_fd != -1)
+    {
+        struct uffdio_writeprotect wp;
+
+        wp.range.start = (ULONG_PTR)base;
+        wp.range.len = size;
+        wp.mode = UFFDIO_WRITEPROTECT_MODE_WP;
+        if (ioctl( uffd_fd, UFFDIO_WRITEPROTECT, &wp ) == -1)
+            ERR( "Could not write protect %p-%p, error %s.\n", base, (char *)base + size, strerror(errno) );
+        return;
+    }
+#endif
     if (use_kernel_writewatch)
     {
         char buffer[17];
@@ -1981,28 +2197,14 @@ static void *alloc_free_area_in_range( struct alloc_area *area, char *base, char
 
 static void *alloc_free_area( void *limit, size_t size, BOOL top_down, int unix_prot, UINT_PTR align_mask )
 {
-    struct range_entry *range, *ranges_start, *ranges_end;
+    struct range_entry *range;
     char *reserve_start, *reserve_end;
     struct alloc_area area;
     char *base, *end;
-    int ranges_inc;
     UINT status;
 
     TRACE("limit %p, size %p, top_down %#x.\n", limit, (void *)size, top_down);
 
-    if (top_down)
-    {
-        ranges_start = free_ranges_end - 1;
-        ranges_end = free_ranges - 1;
-        ranges_inc = -1;
-    }
-    else
-    {
-        ranges_start = free_ranges;
-        ranges_end = free_ranges_end;
-        ranges_inc = 1;
-    }
-
     memset( &area, 0, sizeof(area) );
     area.step = top_down ? -(align_mask + 1) : (align_mask + 1);
     area.size = size;
@@ -2013,7 +2215,8 @@ static void *alloc_free_area( void *limit, size_t size, BOOL top_down, int unix_
     reserve_start = preload_reserve_start;
     reserve_end = preload_reserve_end;
 
-    for (range = ranges_start; range != ranges_end; range += ranges_inc)
+    for (range = top_down ? free_ranges_last() : free_ranges_first(); range;
+         range = top_down ? free_ranges_prev( range ) : free_ranges_next( range ))
     {
         base = range->base;
         end = range->end;
@@ -2363,6 +2566,12 @@ static NTSTATUS decommit_pages( struct file_view *view, size_t start, size_t siz
     if (anon_mmap_fixed( (char *)view->base + start, size, PROT_NONE, 0 ) != MAP_FAILED)
     {
         set_page_vprot_bits( (char *)view->base + start, size, 0, VPROT_COMMITTED );
+        /* the new mapping is no longer registered with the userfaultfd */
+        if (view->protect & VPROT_WRITEWATCH && use_kernel_writewatch)
+        {
+            register_write_watches( (char *)view->base + start, size );
+            reset_write_watches( (char *)view->base + start, size );
+        }
         return STATUS_SUCCESS;
     }
     return STATUS_NO_MEMORY;
@@ -2951,8 +3160,12 @@ void virtual_init(void)
     pthread_mutex_init( &virtual_mutex, &attr );
     pthread_mutexattr_destroy( &attr );
 
-    if (!((env_var = getenv("WINE_DISABLE_KERNEL_WRITEWATCH")) && atoi(env_var))
-            && (pagemap_reset_fd = open("/proc/self/pagemap_reset", O_RDONLY)) != -1)
+    if ((env_var = getenv("WINE_HUGEPAGE_THRESHOLD")))
+        hugepage_threshold = (SIZE_T)strtoul( env_var, NULL, 10 ) << 20;  /* in MB */
+
+    if ((env_var = getenv("WINE_DISABLE_KERNEL_WRITEWATCH")) && atoi(env_var))
+        disable_kernel_writewatch = TRUE;
+    else if ((pagemap_reset_fd = open("/proc/self/pagemap_reset", O_RDONLY)) != -1)
     {
         use_kernel_writewatch = TRUE;
         if ((pagemap_fd = open("/proc/self/pagemap", O_RDONLY)) == -1)
@@ -3004,13 +3217,13 @@ void virtual_init(void)
     assert( alloc_views.base != MAP_FAILED );
     view_block_start = alloc_views.base;
     view_block_end = view_block_start + view_block_size / sizeof(*view_block_start);
-    free_ranges = (void *)((char *)alloc_views.base + view_block_size);
+    range_block_start = (void *)((char *)alloc_views.base + view_block_size);
+    range_block_end = range_block_start + view_block_size / sizeof(*range_block_start);
     pages_vprot = (void *)((char *)alloc_views.base + 2 * view_block_size);
     wine_rb_init( &views_tree, compare_view );
 
-    free_ranges[0].base = (void *)0;
-    free_ranges[0].end = (void *)~0;
-    free_ranges_end = free_ranges + 1;
+    wine_rb_init( &free_ranges, compare_range );
+    free_ranges_add( (void *)0, (void *)~0 );
 
     /* make the DOS area accessible (except the low 64K) to hide bugs in broken apps like Excel 2003 */
     size = (char *)address_space_start - (char *)0x10000;
@@ -4114,6 +4327,22 @@ static NTSTATUS allocate_virtual_memory( void **ret, SIZE_T *size_ptr, ULONG typ
             return STATUS_NOT_SUPPORTED;
     }
 
+    if (type & MEM_LARGE_PAGES)
+    {
+        /* large pages have to be reserved and committed at once, in multiples of the large page size */
+        if ((type & (MEM_RESERVE | MEM_COMMIT)) != (MEM_RESERVE | MEM_COMMIT) ||
+            (type & (MEM_WRITE_WATCH | MEM_RESERVE_PLACEHOLDER | MEM_REPLACE_PLACEHOLDER)) ||
+            (size & large_page_mask) || ((UINT_PTR)*ret & large_page_mask))
+            return STATUS_INVALID_PARAMETER;
+        if (align <= large_page_mask) align = large_page_mask + 1;
+    }
+    else if (hugepage_threshold && size >= hugepage_threshold && !*ret && !align &&
+             (type & MEM_RESERVE) && !(type & (MEM_WRITE_WATCH | MEM_RESERVE_PLACEHOLDER)))
+    {
+        /* align large reservations so that they can use transparent huge pages */
+        align = large_page_mask + 1;
+    }
+
     /* Round parameters to a page boundary */
 
     if (is_beyond_limit( 0, size, working_set_limit )) return STATUS_WORKING_SET_LIMIT_RANGE;
@@ -4166,8 +4395,13 @@ static NTSTATUS allocate_virtual_memory( void **ret, SIZE_T *size_ptr, ULONG typ
         if (!(status = get_vprot_flags( protect, &vprot, FALSE )))
         {
             if (type & MEM_COMMIT) vprot |= VPROT_COMMITTED;
-            if (type & MEM_WRITE_WATCH) vprot |= VPROT_WRITEWATCH;
+            if (type & MEM_WRITE_WATCH)
+            {
+                init_uffd_write_watches();
+                vprot |= VPROT_WRITEWATCH;
+            }
             if (type & MEM_RESERVE_PLACEHOLDER) vprot |= VPROT_PLACEHOLDER;
+            if (type & MEM_LARGE_PAGES) vprot |= SEC_LARGE_PAGES;
             if (protect & PAGE_NOCACHE) vprot |= SEC_NOCACHE;
 
             if (vprot & VPROT_WRITECOPY) status = STATUS_INVALID_PAGE_PROTECTION;
@@ -4175,7 +4409,18 @@ static NTSTATUS allocate_virtual_memory( void **ret, SIZE_T *size_ptr, ULONG typ
             else status = map_view( &view, base, size, type & (MEM_TOP_DOWN | MEM_REPLACE_PLACEHOLDER), vprot, limit,
                                     align ? align - 1 : granularity_mask );
 
-            if (status == STATUS_SUCCESS) base = view->base;
+            if (status == STATUS_SUCCESS)
+            {
+                base = view->base;
+#ifdef MADV_HUGEPAGE
+                /* use transparent huge pages rather than MAP_HUGETLB, so that the view can
+                 * still be decommitted or protected in parts like any other view */
+                if ((vprot & SEC_LARGE_PAGES) ||
+                    (!is_dos_memory && hugepage_threshold && size >= hugepage_threshold &&
+                     !(vprot & (VPROT_WRITEWATCH | VPROT_PLACEHOLDER))))
+                    madvise( base, size, MADV_HUGEPAGE );
+#endif
+            }
         }
     }
     else if (type & MEM_RESET)
@@ -4225,7 +4470,8 @@ static NTSTATUS allocate_virtual_memory( void **ret, SIZE_T *size_ptr, ULONG typ
 NTSTATUS WINAPI NtAllocateVirtualMemory( HANDLE process, PVOID *ret, ULONG_PTR zero_bits,
                                          SIZE_T *size_ptr, ULONG type, ULONG protect )
 {
-    static const ULONG type_mask = MEM_COMMIT | MEM_RESERVE | MEM_TOP_DOWN | MEM_WRITE_WATCH | MEM_RESET;
+    static const ULONG type_mask = MEM_COMMIT | MEM_RESERVE | MEM_TOP_DOWN | MEM_WRITE_WATCH | MEM_RESET
+                                   | MEM_LARGE_PAGES;
     ULONG_PTR limit;
 
     TRACE("%p %p %08lx %x %08x\n", process, *ret, *size_ptr, (int)type, (int)protect );
@@ -4286,7 +4532,8 @@ NTSTATUS WINAPI NtAllocateVirtualMemoryEx( HANDLE process, PVOID *ret, SIZE_T *s
                                            ULONG count )
 {
     static const ULONG type_mask = MEM_COMMIT | MEM_RESERVE | MEM_TOP_DOWN | MEM_WRITE_WATCH
-                                   | MEM_RESET | MEM_RESERVE_PLACEHOLDER | MEM_REPLACE_PLACEHOLDER;
+                                   | MEM_RESET | MEM_RESERVE_PLACEHOLDER | MEM_REPLACE_PLACEHOLDER
+                                   | MEM_LARGE_PAGES;
     ULONG_PTR limit = 0;
     ULONG_PTR align = 0;
 
@@ -4939,7 +5186,10 @@ static NTSTATUS get_working_set_ex( HANDLE process, LPCVOID addr,
                  if (p->VirtualAttributes.Shared && p->VirtualAttributes.Valid)
                      p->VirtualAttributes.ShareCount = 1; /* FIXME */
                  if (p->VirtualAttributes.Valid)
+                 {
                      p->VirtualAttributes.Win32Protection = get_win32_prot( vprot, view->protect );
+                     p->VirtualAttributes.LargePage = !!(view->protect & SEC_LARGE_PAGES);
+                 }
              }
         }
         server_leave_uninterrupted_section( &virtual_mutex, &sigset );
@@ -4988,7 +5238,10 @@ static NTSTATUS get_working_set_ex( HANDLE process, LPCVOID addr,
             if (p->VirtualAttributes.Shared && p->VirtualAttributes.Valid)
                 p->VirtualAttributes.ShareCount = 1; /* FIXME */
             if (p->VirtualAttributes.Valid)
+            {
                 p->VirtualAttributes.Win32Protection = get_win32_prot( vprot, view->protect );
+                p->VirtualAttributes.LargePage = !!(view->protect & SEC_LARGE_PAGES);
+            }
         }
     }
     server_leave_uninterrupted_section( &virtual_mutex, &sigset );
@@ -5581,7 +5834,13 @@ NTSTATUS WINAPI NtGetWriteWatch( HANDLE process, ULONG flags, PVOID base, SIZE_T
         char *addr = base;
         char *end = addr + size;
 
-        if (use_kernel_writewatch)
+        if (uffd_fd != -1)
+        {
+            status = get_uffd_write_watches( addr, end, addresses, count, flags & WRITE_WATCH_FLAG_RESET );
+            *granularity = page_size;
+            goto done;
+        }
+        else if (use_kernel_writewatch)
         {
             static UINT64 buffer[PAGE_FLAGS_BUFFER_LENGTH];
             unsigned int i, length;
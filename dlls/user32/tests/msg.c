@@ -17378,6 +17378,132 @@ static void test_PostMessage(void)
     flush_events();
 }
 
+static DWORD CALLBACK post_message_thread( void *arg )
+{
+    PostMessageA( arg, WM_USER, 2, 0 );
+    return 0;
+}
+
+static void post_message_from_thread( HWND hwnd )
+{
+    HANDLE thread = CreateThread( NULL, 0, post_message_thread, hwnd, 0, NULL );
+    ok( thread != NULL, "CreateThread failed, error %lu\n", GetLastError() );
+    WaitForSingleObject( thread, INFINITE );
+    CloseHandle( thread );
+}
+
+static void test_PostMessage_self(void)
+{
+    DWORD qstatus, ret;
+    HWND hwnd;
+    MSG msg;
+    int i;
+
+    hwnd = CreateWindowExA( 0, "static", NULL, WS_POPUP, 0, 0, 0, 0, 0, 0, 0, NULL );
+    ok( hwnd != NULL, "CreateWindowEx failed, error %lu\n", GetLastError() );
+    flush_events();
+
+    /* messages posted by the thread itself and by other threads are kept in order */
+
+    PostMessageA( hwnd, WM_USER, 1, 0 );
+    post_message_from_thread( hwnd );
+    PostMessageA( hwnd, WM_USER, 3, 0 );
+    for (i = 1; i <= 3; i++)
+    {
+        ret = PeekMessageA( &msg, hwnd, WM_USER, WM_USER, PM_REMOVE );
+        ok( ret && msg.hwnd == hwnd && msg.wParam == i, "%d: got ret %lu hwnd %p wParam %Iu\n",
+            i, ret, msg.hwnd, msg.wParam );
+    }
+    ret = PeekMessageA( &msg, hwnd, WM_USER, WM_USER, PM_REMOVE );
+    ok( !ret, "got message %04x wParam %Iu\n", msg.message, msg.wParam );
+
+    PostMessageA( hwnd, WM_USER, 1, 0 );
+    ret = PeekMessageA( &msg, hwnd, WM_USER, WM_USER, PM_NOREMOVE );
+    ok( ret && msg.wParam == 1, "got ret %lu wParam %Iu\n", ret, msg.wParam );
+    post_message_from_thread( hwnd );
+    ret = GetMessageA( &msg, hwnd, WM_USER, WM_USER );
+    ok( ret && msg.wParam == 1, "got ret %lu wParam %Iu\n", ret, msg.wParam );
+    ret = GetMessageA( &msg, hwnd, WM_USER, WM_USER );
+    ok( ret && msg.wParam == 2, "got ret %lu wParam %Iu\n", ret, msg.wParam );
+
+    /* filtered PeekMessage */
+
+    PostMessageA( hwnd, WM_USER, 0, 0 );
+    PostMessageA( hwnd, WM_USER + 1, 0, 0 );
+    PostThreadMessageA( GetCurrentThreadId(), WM_USER + 2, 0, 0 );
+
+    ret = PeekMessageA( &msg, 0, 0, 0, PM_REMOVE | PM_QS_INPUT );
+    ok( !ret, "got message %04x\n", msg.message );
+    ret = PeekMessageA( &msg, 0, WM_USER + 1, WM_USER + 2, PM_REMOVE );
+    ok( ret && msg.hwnd == hwnd && msg.message == WM_USER + 1, "got ret %lu hwnd %p message %04x\n",
+        ret, msg.hwnd, msg.message );
+    ret = PeekMessageA( &msg, (HWND)-1, 0, 0, PM_REMOVE );
+    ok( ret && !msg.hwnd && msg.message == WM_USER + 2, "got ret %lu hwnd %p message %04x\n",
+        ret, msg.hwnd, msg.message );
+    ret = PeekMessageA( &msg, hwnd, 0, 0, PM_REMOVE | PM_QS_POSTMESSAGE );
+    ok( ret && msg.hwnd == hwnd && msg.message == WM_USER, "got ret %lu hwnd %p message %04x\n",
+        ret, msg.hwnd, msg.message );
+    ret = PeekMessageA( &msg, 0, WM_USER, WM_USER + 2, PM_REMOVE );
+    ok( !ret, "got message %04x\n", msg.message );
+
+    /* GetQueueStatus and MsgWaitForMultipleObjects */
+
+    PostMessageA( hwnd, WM_USER, 0, 0 );
+    qstatus = GetQueueStatus( QS_POSTMESSAGE );
+    ok( qstatus == MAKELONG(QS_POSTMESSAGE, QS_POSTMESSAGE), "wrong qstatus %08lx\n", qstatus );
+    qstatus = GetQueueStatus( QS_POSTMESSAGE );
+    ok( qstatus == MAKELONG(0, QS_POSTMESSAGE), "wrong qstatus %08lx\n", qstatus );
+    ret = PeekMessageA( &msg, hwnd, WM_USER, WM_USER, PM_REMOVE );
+    ok( ret, "PeekMessage failed\n" );
+    qstatus = GetQueueStatus( QS_POSTMESSAGE );
+    ok( qstatus == 0, "wrong qstatus %08lx\n", qstatus );
+
+    PostMessageA( hwnd, WM_USER, 0, 0 );
+    ret = PeekMessageA( &msg, hwnd, WM_USER, WM_USER, PM_NOREMOVE );
+    ok( ret, "PeekMessage failed\n" );
+    /* the message has already been seen */
+    ret = MsgWaitForMultipleObjects( 0, NULL, FALSE, 0, QS_POSTMESSAGE );
+    ok( ret == WAIT_TIMEOUT, "MsgWaitForMultipleObjects returned %lx\n", ret );
+    qstatus = GetQueueStatus( QS_POSTMESSAGE );
+    ok( qstatus == MAKELONG(0, QS_POSTMESSAGE), "wrong qstatus %08lx\n", qstatus );
+    PostMessageA( hwnd, WM_USER, 1, 0 );
+    ret = MsgWaitForMultipleObjects( 0, NULL, FALSE, 0, QS_POSTMESSAGE );
+    ok( ret == WAIT_OBJECT_0, "MsgWaitForMultipleObjects returned %lx\n", ret );
+    for (i = 0; i < 2; i++)
+    {
+        ret = PeekMessageA( &msg, hwnd, WM_USER, WM_USER, PM_REMOVE );
+        ok( ret && msg.wParam == i, "%d: got ret %lu wParam %Iu\n", i, ret, msg.wParam );
+    }
+
+    /* WM_QUIT from PostQuitMessage comes after the posted messages */
+
+    PostMessageA( hwnd, WM_USER, 0, 0 );
+    PostQuitMessage( 0xbeef );
+    PostMessageA( hwnd, WM_USER, 1, 0 );
+    for (i = 0; i < 2; i++)
+    {
+        ret = GetMessageA( &msg, 0, 0, 0 );
+        ok( ret && msg.message == WM_USER && msg.wParam == i, "%d: got ret %lu message %04x wParam %Iu\n",
+            i, ret, msg.message, msg.wParam );
+    }
+    ret = GetMessageA( &msg, 0, 0, 0 );
+    ok( !ret && msg.message == WM_QUIT && msg.wParam == 0xbeef, "got ret %lu message %04x wParam %Iu\n",
+        ret, msg.message, msg.wParam );
+
+    /* messages posted to a destroyed window are discarded */
+
+    PostMessageA( hwnd, WM_USER, 0, 0 );
+    PostThreadMessageA( GetCurrentThreadId(), WM_USER + 1, 0, 0 );
+    DestroyWindow( hwnd );
+    ret = PeekMessageA( &msg, 0, WM_USER, WM_USER + 1, PM_REMOVE );
+    ok( ret && !msg.hwnd && msg.message == WM_USER + 1, "got ret %lu hwnd %p message %04x\n",
+        ret, msg.hwnd, msg.message );
+    ret = PeekMessageA( &msg, 0, WM_USER, WM_USER + 1, PM_REMOVE );
+    ok( !ret, "got message %04x\n", msg.message );
+
+    flush_events();
+}
+
 static WPARAM g_broadcast_wparam;
 static LRESULT WINAPI broadcast_test_proc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam)
 {
@@ -19627,6 +19753,7 @@ START_TEST(msg)
     test_SetFocus();
     test_SetParent();
     test_PostMessage();
+    test_PostMessage_self();
     test_broadcast();
     test_ShowWindow();
     test_PeekMessage();
@@ -1222,7 +1222,7 @@ DWORD stretch_bitmapinfo( const BITMAPINFO *src_info, void *src_bits, struct bit
 
     if (mode == HALFTONE)
     {
-        dst_dib.funcs->halftone( &dst_dib, dst, &src_dib, src );
+        if (!dst_dib.funcs->halftone( &dst_dib, dst, &src_dib, src )) return ERROR_OUTOFMEMORY;
         goto done;
     }
 
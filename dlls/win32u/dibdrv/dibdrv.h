@@ -209,7 +209,7 @@ typedef struct primitive_funcs
     void             (* shrink_row)(const dib_info *dst_dib, const POINT *dst_start,
                                     const dib_info *src_dib, const POINT *src_start,
                                     const struct stretch_params *params, int mode, BOOL keep_dst);
-    void               (* halftone)(const dib_info *dst_dib, const struct bitblt_coords *dst,
+    BOOL               (* halftone)(const dib_info *dst_dib, const struct bitblt_coords *dst,
                                     const dib_info *src_dib, const struct bitblt_coords *src);
 } primitive_funcs;
 
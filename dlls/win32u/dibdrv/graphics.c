@@ -47,10 +47,15 @@ enum glyph_type
 #define GLYPH_CACHE_PAGE_SIZE  0x100
 #define GLYPH_CACHE_PAGES      (0x10000 / GLYPH_CACHE_PAGE_SIZE)
 
+#define FONT_CACHE_BUCKETS     64
+#define GLYPH_CACHE_MAX_SIZE   (16 * 1024 * 1024)  /* maximum size of the cached glyph bitmaps */
+
 struct cached_font
 {
-    struct list           entry;
+    struct list           entry;       /* entry in the font_cache LRU list */
+    struct cached_font   *hash_next;   /* next font in the same font_cache_buckets chain */
     LONG                  ref;
+    LONG                  size;        /* size of the cached glyphs */
     DWORD                 hash;
     LOGFONTW              lf;
     XFORM                 xform;
@@ -59,6 +64,9 @@ struct cached_font
 };
 
 static struct list font_cache = LIST_INIT( font_cache );
+static struct cached_font *font_cache_buckets[FONT_CACHE_BUCKETS];
+static LONG glyph_cache_size;
+static UINT font_cache_hits, font_cache_misses;
 
 static pthread_mutex_t font_cache_lock = PTHREAD_MUTEX_INITIALIZER;
 
@@ -631,10 +639,44 @@ static int font_cache_cmp( const struct cached_font *p1, const struct cached_fon
     return ret;
 }
 
+/* free the glyphs of an unused font, font_cache_lock must be held */
+static void free_cached_font_glyphs( struct cached_font *font )
+{
+    UINT i, j, k;
+
+    for (i = 0; i < GLYPH_NBTYPES; i++)
+    {
+        for (j = 0; j < GLYPH_CACHE_PAGES; j++)
+        {
+            if (!font->glyphs[i][j]) continue;
+            for (k = 0; k < GLYPH_CACHE_PAGE_SIZE; k++)
+                free( font->glyphs[i][j][k] );
+            free( font->glyphs[i][j] );
+            font->glyphs[i][j] = NULL;
+        }
+    }
+    InterlockedExchangeAdd( &glyph_cache_size, -font->size );
+    font->size = 0;
+}
+
+/* free the glyphs of the least recently used unused fonts to make room for size more bytes */
+static void trim_glyph_cache( LONG size )
+{
+    struct cached_font *font;
+
+    pthread_mutex_lock( &font_cache_lock );
+    LIST_FOR_EACH_ENTRY_REV( font, &font_cache, struct cached_font, entry )
+    {
+        if (glyph_cache_size + size <= GLYPH_CACHE_MAX_SIZE) break;
+        if (!font->ref) free_cached_font_glyphs( font );
+    }
+    pthread_mutex_unlock( &font_cache_lock );
+}
+
 static struct cached_font *add_cached_font( DC *dc, HFONT hfont, UINT aa_flags )
 {
-    struct cached_font font, *ptr, *last_unused = NULL;
-    UINT i = 0, j, k;
+    struct cached_font font, *ptr, **bucket, *last_unused = NULL;
+    UINT i = 0;
 
     NtGdiExtGetObjectW( hfont, sizeof(font.lf), &font.lf );
     font.xform = dc->xformWorld2Vport;
@@ -650,35 +692,38 @@ static struct cached_font *add_cached_font( DC *dc, HFONT hfont, UINT aa_flags )
     font.hash = font_cache_hash( &font );
 
     pthread_mutex_lock( &font_cache_lock );
-    LIST_FOR_EACH_ENTRY( ptr, &font_cache, struct cached_font, entry )
+
+    bucket = &font_cache_buckets[font.hash % FONT_CACHE_BUCKETS];
+
+    for (ptr = *bucket; ptr; ptr = ptr->hash_next)
     {
         if (!font_cache_cmp( &font, ptr ))
         {
             InterlockedIncrement( &ptr->ref );
             list_remove( &ptr->entry );
+            font_cache_hits++;
             goto done;
         }
-        if (!ptr->ref)
-        {
-            i++;
-            last_unused = ptr;
-        }
+    }
+    font_cache_misses++;
+
+    i = 0;
+    LIST_FOR_EACH_ENTRY_REV( ptr, &font_cache, struct cached_font, entry )
+    {
+        if (ptr->ref) continue;
+        if (!last_unused) last_unused = ptr;
+        if (++i > 5) break;
     }
 
     if (i > 5)  /* keep at least 5 of the most-recently used fonts around */
     {
+        struct cached_font **prev = &font_cache_buckets[last_unused->hash % FONT_CACHE_BUCKETS];
+
         ptr = last_unused;
-        for (i = 0; i < GLYPH_NBTYPES; i++)
-        {
-            for (j = 0; j < GLYPH_CACHE_PAGES; j++)
-            {
-                if (!ptr->glyphs[i][j]) continue;
-                for (k = 0; k < GLYPH_CACHE_PAGE_SIZE; k++)
-                    free( ptr->glyphs[i][j][k] );
-                free( ptr->glyphs[i][j] );
-            }
-        }
+        free_cached_font_glyphs( ptr );
         list_remove( &ptr->entry );
+        while (*prev != ptr) prev = &(*prev)->hash_next;
+        *prev = ptr->hash_next;
     }
     else if (!(ptr = malloc( sizeof(*ptr) )))
     {
@@ -688,11 +733,16 @@ static struct cached_font *add_cached_font( DC *dc, HFONT hfont, UINT aa_flags )
 
     *ptr = font;
     ptr->ref = 1;
+    ptr->size = 0;
     memset( ptr->glyphs, 0, sizeof(ptr->glyphs) );
+    ptr->hash_next = *bucket;
+    *bucket = ptr;
+
 done:
     list_add_head( &font_cache, &ptr->entry );
+    TRACE( "%d %s -> %p, %u hits %u misses, %d bytes of glyphs\n", (int)ptr->lf.lfHeight,
+           debugstr_w(ptr->lf.lfFaceName), ptr, font_cache_hits, font_cache_misses, (int)glyph_cache_size );
     pthread_mutex_unlock( &font_cache_lock );
-    TRACE( "%d %s -> %p\n", (int)ptr->lf.lfHeight, debugstr_w(ptr->lf.lfFaceName), ptr );
     return ptr;
 }
 
@@ -702,13 +752,25 @@ void release_cached_font( struct cached_font *font )
 }
 
 static struct cached_glyph *add_cached_glyph( struct cached_font *font, UINT index, UINT flags,
-                                              struct cached_glyph *glyph )
+                                              struct cached_glyph *glyph, LONG size, BOOL *cached )
 {
     struct cached_glyph *ret;
     enum glyph_type type = (flags & ETO_GLYPH_INDEX) ? GLYPH_INDEX : GLYPH_WCHAR;
     UINT page = index / GLYPH_CACHE_PAGE_SIZE;
     UINT entry = index % GLYPH_CACHE_PAGE_SIZE;
 
+    if (glyph_cache_size + size > GLYPH_CACHE_MAX_SIZE)
+    {
+        /* the glyphs of fonts in use can't be freed, as they are looked up without locking,
+         * so if they fill the cache the glyph is returned without being cached */
+        trim_glyph_cache( size );
+        if (glyph_cache_size + size > GLYPH_CACHE_MAX_SIZE)
+        {
+            *cached = FALSE;
+            return glyph;
+        }
+    }
+
     if (!font->glyphs[type][page])
     {
         struct cached_glyph **ptr;
@@ -723,7 +785,12 @@ static struct cached_glyph *add_cached_glyph( struct cached_font *font, UINT ind
             free( ptr );
     }
     ret = InterlockedCompareExchangePointer( (void **)&font->glyphs[type][page][entry], glyph, NULL );
-    if (!ret) ret = glyph;
+    if (!ret)
+    {
+        InterlockedExchangeAdd( &font->size, size );
+        InterlockedExchangeAdd( &glyph_cache_size, size );
+        ret = glyph;
+    }
     else free( glyph );
     return ret;
 }
@@ -758,27 +825,50 @@ static inline void get_text_bkgnd_masks( DC *dc, const dib_info *dib, rop_mask *
     }
 }
 
-static void draw_glyph( dib_info *dib, int x, int y, const GLYPHMETRICS *metrics,
-                        const dib_info *glyph_dib, DWORD text_color,
-                        const struct font_intensities *intensity,
-                        const struct clipped_rects *clipped_rects, RECT *bounds )
+/* glyphs of a string are placed in batches and composited one clip rectangle at a time */
+#define GLYPH_BATCH_SIZE 64
+
+struct glyph_batch
 {
-    int i;
-    RECT rect, clipped_rect;
-    POINT src_origin;
+    RECT bounds;  /* union of the glyph rectangles */
+    UINT count;
+    struct
+    {
+        const struct cached_glyph *glyph;
+        RECT rect;
+    } glyphs[GLYPH_BATCH_SIZE];
+};
 
-    rect.left   = x          + metrics->gmptGlyphOrigin.x;
-    rect.top    = y          - metrics->gmptGlyphOrigin.y;
-    rect.right  = rect.left  + metrics->gmBlackBoxX;
-    rect.bottom = rect.top   + metrics->gmBlackBoxY;
-    if (bounds) add_bounds_rect( bounds, &rect );
+static void draw_glyph_batch( dib_info *dib, dib_info *glyph_dib, const struct glyph_batch *batch,
+                              DWORD text_color, const struct font_intensities *intensity,
+                              const struct clipped_rects *clipped_rects )
+{
+    const struct cached_glyph *glyph;
+    RECT clip, clipped_rect;
+    POINT src_origin;
+    int i;
+    UINT j;
 
     for (i = 0; i < clipped_rects->count; i++)
     {
-        if (intersect_rect( &clipped_rect, &rect, clipped_rects->rects + i ))
+        /* clipped rectangles are sorted top to bottom */
+        if (clipped_rects->rects[i].top >= batch->bounds.bottom) break;
+        if (!intersect_rect( &clip, &batch->bounds, clipped_rects->rects + i )) continue;
+
+        for (j = 0; j < batch->count; j++)
         {
-            src_origin.x = clipped_rect.left - rect.left;
-            src_origin.y = clipped_rect.top  - rect.top;
+            if (!intersect_rect( &clipped_rect, &batch->glyphs[j].rect, &clip )) continue;
+
+            glyph = batch->glyphs[j].glyph;
+            glyph_dib->width       = glyph->metrics.gmBlackBoxX;
+            glyph_dib->height      = glyph->metrics.gmBlackBoxY;
+            glyph_dib->rect.right  = glyph->metrics.gmBlackBoxX;
+            glyph_dib->rect.bottom = glyph->metrics.gmBlackBoxY;
+            glyph_dib->stride      = get_dib_stride( glyph->metrics.gmBlackBoxX, glyph_dib->bit_count );
+            glyph_dib->bits.ptr    = (void *)glyph->bits;
+
+            src_origin.x = clipped_rect.left - batch->glyphs[j].rect.left;
+            src_origin.y = clipped_rect.top  - batch->glyphs[j].rect.top;
 
             if (glyph_dib->bit_count == 32)
                 dib->funcs->draw_subpixel_glyph( dib, &clipped_rect, glyph_dib, &src_origin,
@@ -821,8 +911,10 @@ static const int padding[4] = {0, 3, 2, 1};
  *
  * For non-antialiased bitmaps convert them to the 17-level format
  * using only values 0 or 16.
+ * cached is set to FALSE if the glyph has to be freed by the caller.
  */
-static struct cached_glyph *cache_glyph_bitmap( DC *dc, struct cached_font *font, UINT index, UINT flags )
+static struct cached_glyph *cache_glyph_bitmap( DC *dc, struct cached_font *font, UINT index, UINT flags,
+                                                BOOL *cached )
 {
     UINT ggo_flags = font->aa_flags;
     static const MAT2 identity = { {0,1}, {0,0}, {0,0}, {0,1} };
@@ -884,7 +976,7 @@ static struct cached_glyph *cache_glyph_bitmap( DC *dc, struct cached_font *font
 
 done:
     glyph->metrics = metrics;
-    return add_cached_glyph( font, index, flags, glyph );
+    return add_cached_glyph( font, index, flags, glyph, FIELD_OFFSET( struct cached_glyph, bits[size] ), cached );
 }
 
 static void render_string( DC *dc, dib_info *dib, struct cached_font *font, INT x, INT y,
@@ -893,9 +985,11 @@ static void render_string( DC *dc, dib_info *dib, struct cached_font *font, INT
 {
     UINT i;
     struct cached_glyph *glyph;
+    struct glyph_batch batch;
     dib_info glyph_dib;
     DWORD text_color;
     struct font_intensities intensity;
+    RECT rect;
 
     glyph_dib.bit_count    = get_glyph_depth( font->aa_flags );
     glyph_dib.rect.left    = 0;
@@ -910,19 +1004,34 @@ static void render_string( DC *dc, dib_info *dib, struct cached_font *font, INT
     else
         get_aa_ranges( dib->funcs->pixel_to_colorref( dib, text_color ), intensity.ranges );
 
+    batch.count = 0;
+    reset_bounds( &batch.bounds );
+
     for (i = 0; i < count; i++)
     {
+        BOOL cached = TRUE;
+
         if (!(glyph = get_cached_glyph( font, str[i], flags )) &&
-            !(glyph = cache_glyph_bitmap( dc, font, str[i], flags ))) continue;
+            !(glyph = cache_glyph_bitmap( dc, font, str[i], flags, &cached ))) continue;
 
-        glyph_dib.width       = glyph->metrics.gmBlackBoxX;
-        glyph_dib.height      = glyph->metrics.gmBlackBoxY;
-        glyph_dib.rect.right  = glyph->metrics.gmBlackBoxX;
-        glyph_dib.rect.bottom = glyph->metrics.gmBlackBoxY;
-        glyph_dib.stride      = get_dib_stride( glyph->metrics.gmBlackBoxX, glyph_dib.bit_count );
-        glyph_dib.bits.ptr    = glyph->bits;
+        rect.left   = x          + glyph->metrics.gmptGlyphOrigin.x;
+        rect.top    = y          - glyph->metrics.gmptGlyphOrigin.y;
+        rect.right  = rect.left  + glyph->metrics.gmBlackBoxX;
+        rect.bottom = rect.top   + glyph->metrics.gmBlackBoxY;
+        if (bounds) add_bounds_rect( bounds, &rect );
 
-        draw_glyph( dib, x, y, &glyph->metrics, &glyph_dib, text_color, &intensity, clipped_rects, bounds );
+        if (!IsRectEmpty( &rect ))
+        {
+            batch.glyphs[batch.count].glyph = glyph;
+            batch.glyphs[batch.count].rect  = rect;
+            add_bounds_rect( &batch.bounds, &rect );
+            if (++batch.count == GLYPH_BATCH_SIZE || !cached)
+            {
+                draw_glyph_batch( dib, &glyph_dib, &batch, text_color, &intensity, clipped_rects );
+                batch.count = 0;
+                reset_bounds( &batch.bounds );
+            }
+        }
 
         if (dx)
         {
@@ -939,7 +1048,11 @@ static void render_string( DC *dc, dib_info *dib, struct cached_font *font, INT
             x += glyph->metrics.gmCellIncX;
             y += glyph->metrics.gmCellIncY;
         }
+
+        if (!cached) free( glyph );
     }
+
+    if (batch.count) draw_glyph_batch( dib, &glyph_dib, &batch, text_color, &intensity, clipped_rects );
 }
 
 BOOL render_aa_text_bitmapinfo( DC *dc, BITMAPINFO *info, struct gdi_image_bits *bits,
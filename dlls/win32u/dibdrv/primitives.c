@@ -23,6 +23,9 @@
 #endif
 
 #include <assert.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "ntgdi_private.h"
 #include "dibdrv.h"
@@ -268,10 +271,26 @@ static inline void memset_16( WORD *start, WORD val, DWORD size )
 #endif
 }
 
+static inline void do_rop_row_32( DWORD *ptr, DWORD and, DWORD xor, int len )
+{
+    int x = 0;
+
+#ifdef __SSE2__
+    __m128i and_vec = _mm_set1_epi32( and ), xor_vec = _mm_set1_epi32( xor );
+
+    for (; x + 4 <= len; x += 4)
+    {
+        __m128i val = _mm_loadu_si128( (__m128i *)(ptr + x) );
+        _mm_storeu_si128( (__m128i *)(ptr + x), _mm_xor_si128( _mm_and_si128( val, and_vec ), xor_vec ));
+    }
+#endif
+    for (; x < len; x++) do_rop_32( ptr + x, and, xor );
+}
+
 static void solid_rects_32(const dib_info *dib, int num, const RECT *rc, DWORD and, DWORD xor)
 {
-    DWORD *ptr, *start;
-    int x, y, i;
+    DWORD *start;
+    int y, i;
 
     for(i = 0; i < num; i++, rc++)
     {
@@ -280,8 +299,7 @@ static void solid_rects_32(const dib_info *dib, int num, const RECT *rc, DWORD a
         start = get_pixel_ptr_32(dib, rc->left, rc->top);
         if (and)
             for(y = rc->top; y < rc->bottom; y++, start += dib->stride / 4)
-                for(x = rc->left, ptr = start; x < rc->right; x++)
-                    do_rop_32(ptr++, and, xor);
+                do_rop_row_32( start, and, xor, rc->right - rc->left );
         else
             for(y = rc->top; y < rc->bottom; y++, start += dib->stride / 4)
                 memset_32( start, xor, rc->right - rc->left );
@@ -2106,6 +2124,118 @@ static DWORD colorref_to_pixel_masks(const dib_info *dib, COLORREF colour)
     return rgb_to_pixel_masks(dib, GetRValue(colour), GetGValue(colour), GetBValue(colour));
 }
 
+/* expand a row of 16-bpp pixels with 5-bit red and blue and 5 or 6-bit green to 8888 */
+static void convert_row_16_to_8888( DWORD *dst, const WORD *src, int len, int red_shift,
+                                    int green_shift, int green_len, int blue_shift )
+{
+    DWORD r, g, b, green_mask = (1 << green_len) - 1;
+    int x = 0;
+
+#ifdef __SSE2__
+    const __m128i mask5 = _mm_set1_epi16( 0x1f ), mask_g = _mm_set1_epi16( green_mask );
+    const __m128i rs = _mm_cvtsi32_si128( red_shift ), gs = _mm_cvtsi32_si128( green_shift );
+    const __m128i bs = _mm_cvtsi32_si128( blue_shift );
+    const __m128i g_up = _mm_cvtsi32_si128( 8 - green_len ), g_down = _mm_cvtsi32_si128( 2 * green_len - 8 );
+
+    for (; x + 8 <= len; x += 8)
+    {
+        __m128i val = _mm_loadu_si128( (const __m128i *)(src + x) );
+        __m128i r5 = _mm_and_si128( _mm_srl_epi16( val, rs ), mask5 );
+        __m128i g5 = _mm_and_si128( _mm_srl_epi16( val, gs ), mask_g );
+        __m128i b5 = _mm_and_si128( _mm_srl_epi16( val, bs ), mask5 );
+        __m128i r8 = _mm_or_si128( _mm_slli_epi16( r5, 3 ), _mm_srli_epi16( r5, 2 ));
+        __m128i g8 = _mm_or_si128( _mm_sll_epi16( g5, g_up ), _mm_srl_epi16( g5, g_down ));
+        __m128i b8 = _mm_or_si128( _mm_slli_epi16( b5, 3 ), _mm_srli_epi16( b5, 2 ));
+        __m128i gb = _mm_or_si128( _mm_slli_epi16( g8, 8 ), b8 );
+
+        _mm_storeu_si128( (__m128i *)(dst + x), _mm_unpacklo_epi16( gb, r8 ));
+        _mm_storeu_si128( (__m128i *)(dst + x + 4), _mm_unpackhi_epi16( gb, r8 ));
+    }
+#endif
+    for (; x < len; x++)
+    {
+        r = (src[x] >> red_shift) & 0x1f;
+        g = (src[x] >> green_shift) & green_mask;
+        b = (src[x] >> blue_shift) & 0x1f;
+        dst[x] = (r << 3 | r >> 2) << 16 |
+                 (g << (8 - green_len) | g >> (2 * green_len - 8)) << 8 |
+                 (b << 3 | b >> 2);
+    }
+}
+
+/* pack a row of 8888 pixels to 16-bpp, keeping the top bits of each channel */
+static void convert_row_8888_to_16( WORD *dst, const DWORD *src, int len, int red_shift, DWORD red_mask,
+                                    int green_shift, DWORD green_mask, int blue_shift, DWORD blue_mask )
+{
+    int x = 0;
+
+#ifdef __SSE2__
+    const __m128i rm = _mm_set1_epi32( red_mask ), gm = _mm_set1_epi32( green_mask );
+    const __m128i bm = _mm_set1_epi32( blue_mask );
+    const __m128i rs = _mm_cvtsi32_si128( red_shift ), gs = _mm_cvtsi32_si128( green_shift );
+    const __m128i bs = _mm_cvtsi32_si128( blue_shift );
+
+    for (; x + 8 <= len; x += 8)
+    {
+        __m128i lo = _mm_loadu_si128( (const __m128i *)(src + x) );
+        __m128i hi = _mm_loadu_si128( (const __m128i *)(src + x + 4) );
+
+        lo = _mm_or_si128( _mm_or_si128( _mm_and_si128( _mm_srl_epi32( lo, rs ), rm ),
+                                         _mm_and_si128( _mm_srl_epi32( lo, gs ), gm )),
+                           _mm_and_si128( _mm_srl_epi32( lo, bs ), bm ));
+        hi = _mm_or_si128( _mm_or_si128( _mm_and_si128( _mm_srl_epi32( hi, rs ), rm ),
+                                         _mm_and_si128( _mm_srl_epi32( hi, gs ), gm )),
+                           _mm_and_si128( _mm_srl_epi32( hi, bs ), bm ));
+        /* sign extend so that the saturating pack keeps the low 16 bits */
+        lo = _mm_srai_epi32( _mm_slli_epi32( lo, 16 ), 16 );
+        hi = _mm_srai_epi32( _mm_slli_epi32( hi, 16 ), 16 );
+        _mm_storeu_si128( (__m128i *)(dst + x), _mm_packs_epi32( lo, hi ));
+    }
+#endif
+    for (; x < len; x++)
+        dst[x] = ((src[x] >> red_shift) & red_mask) |
+                 ((src[x] >> green_shift) & green_mask) |
+                 ((src[x] >> blue_shift) & blue_mask);
+}
+
+/* expand a row of 24-bpp pixels to 8888, reading four pixels as three dwords */
+static void convert_row_888_to_8888( DWORD *dst, const BYTE *src, int len )
+{
+    DWORD val[3];
+    int x = 0;
+
+    for (; x + 4 <= len; x += 4, src += 12)
+    {
+        memcpy( val, src, sizeof(val) );
+        dst[x]     = val[0] & 0xffffff;
+        dst[x + 1] = (val[0] >> 24) | ((val[1] & 0xffff) << 8);
+        dst[x + 2] = (val[1] >> 16) | ((val[2] & 0xff) << 16);
+        dst[x + 3] = val[2] >> 8;
+    }
+    for (; x < len; x++, src += 3) dst[x] = src[0] | src[1] << 8 | src[2] << 16;
+}
+
+/* pack a row of 8888 pixels to 24-bpp, writing four pixels as three dwords */
+static void convert_row_8888_to_888( BYTE *dst, const DWORD *src, int len )
+{
+    DWORD val[3];
+    int x = 0;
+
+    for (; x + 4 <= len; x += 4, dst += 12)
+    {
+        val[0] = (src[x] & 0xffffff) | (src[x + 1] << 24);
+        val[1] = ((src[x + 1] >> 8) & 0xffff) | (src[x + 2] << 16);
+        val[2] = ((src[x + 2] >> 16) & 0xff) | (src[x + 3] << 8);
+        memcpy( dst, val, sizeof(val) );
+    }
+    for (; x < len; x++)
+    {
+        *dst++ = src[x];
+        *dst++ = src[x] >> 8;
+        *dst++ = src[x] >> 16;
+    }
+}
+
 static DWORD colorref_to_pixel_555(const dib_info *dib, COLORREF color)
 {
     return ( ((color >> 19) & 0x1f) | ((color >> 6) & 0x03e0) | ((color << 7) & 0x7c00) );
@@ -2285,22 +2415,12 @@ static void convert_to_8888(dib_info *dst, const dib_info *src, const RECT *src_
 
     case 24:
     {
-        BYTE *src_start = get_pixel_ptr_24(src, src_rect->left, src_rect->top), *src_pixel;
+        BYTE *src_start = get_pixel_ptr_24(src, src_rect->left, src_rect->top);
 
         for(y = src_rect->top; y < src_rect->bottom; y++)
         {
-            dst_pixel = dst_start;
-            src_pixel = src_start;
-            for(x = src_rect->left; x < src_rect->right; x++)
-            {
-                RGBQUAD rgb;
-                rgb.rgbBlue  = *src_pixel++;
-                rgb.rgbGreen = *src_pixel++;
-                rgb.rgbRed   = *src_pixel++;
-
-                *dst_pixel++ = ((rgb.rgbRed << 16) & 0xff0000) | ((rgb.rgbGreen << 8) & 0x00ff00) | (rgb.rgbBlue & 0x0000ff);
-            }
-            if(pad_size) memset(dst_pixel, 0, pad_size);
+            convert_row_888_to_8888(dst_start, src_start, src_rect->right - src_rect->left);
+            if(pad_size) memset(dst_start + (src_rect->right - src_rect->left), 0, pad_size);
             dst_start += dst->stride / 4;
             src_start += src->stride;
         }
@@ -2314,58 +2434,19 @@ static void convert_to_8888(dib_info *dst, const dib_info *src, const RECT *src_
         {
             for(y = src_rect->top; y < src_rect->bottom; y++)
             {
-                dst_pixel = dst_start;
-                src_pixel = src_start;
-                for(x = src_rect->left; x < src_rect->right; x++)
-                {
-                    src_val = *src_pixel++;
-                    *dst_pixel++ = ((src_val << 9) & 0xf80000) | ((src_val << 4) & 0x070000) |
-                                   ((src_val << 6) & 0x00f800) | ((src_val << 1) & 0x000700) |
-                                   ((src_val << 3) & 0x0000f8) | ((src_val >> 2) & 0x000007);
-                }
-                if(pad_size) memset(dst_pixel, 0, pad_size);
-                dst_start += dst->stride / 4;
-                src_start += src->stride / 2;
-            }
-        }
-        else if(src->red_len == 5 && src->green_len == 5 && src->blue_len == 5)
-        {
-            for(y = src_rect->top; y < src_rect->bottom; y++)
-            {
-                dst_pixel = dst_start;
-                src_pixel = src_start;
-                for(x = src_rect->left; x < src_rect->right; x++)
-                {
-                    src_val = *src_pixel++;
-                    *dst_pixel++ = (((src_val >> src->red_shift)   << 19) & 0xf80000) |
-                                   (((src_val >> src->red_shift)   << 14) & 0x070000) |
-                                   (((src_val >> src->green_shift) << 11) & 0x00f800) |
-                                   (((src_val >> src->green_shift) <<  6) & 0x000700) |
-                                   (((src_val >> src->blue_shift)  <<  3) & 0x0000f8) |
-                                   (((src_val >> src->blue_shift)  >>  2) & 0x000007);
-                }
-                if(pad_size) memset(dst_pixel, 0, pad_size);
+                convert_row_16_to_8888(dst_start, src_start, src_rect->right - src_rect->left, 10, 5, 5, 0);
+                if(pad_size) memset(dst_start + (src_rect->right - src_rect->left), 0, pad_size);
                 dst_start += dst->stride / 4;
                 src_start += src->stride / 2;
             }
         }
-        else if(src->red_len == 5 && src->green_len == 6 && src->blue_len == 5)
+        else if(src->red_len == 5 && (src->green_len == 5 || src->green_len == 6) && src->blue_len == 5)
         {
             for(y = src_rect->top; y < src_rect->bottom; y++)
             {
-                dst_pixel = dst_start;
-                src_pixel = src_start;
-                for(x = src_rect->left; x < src_rect->right; x++)
-                {
-                    src_val = *src_pixel++;
-                    *dst_pixel++ = (((src_val >> src->red_shift)   << 19) & 0xf80000) |
-                                   (((src_val >> src->red_shift)   << 14) & 0x070000) |
-                                   (((src_val >> src->green_shift) << 10) & 0x00fc00) |
-                                   (((src_val >> src->green_shift) <<  4) & 0x000300) |
-                                   (((src_val >> src->blue_shift)  <<  3) & 0x0000f8) |
-                                   (((src_val >> src->blue_shift)  >>  2) & 0x000007);
-                }
-                if(pad_size) memset(dst_pixel, 0, pad_size);
+                convert_row_16_to_8888(dst_start, src_start, src_rect->right - src_rect->left,
+                                       src->red_shift, src->green_shift, src->green_len, src->blue_shift);
+                if(pad_size) memset(dst_start + (src_rect->right - src_rect->left), 0, pad_size);
                 dst_start += dst->stride / 4;
                 src_start += src->stride / 2;
             }
@@ -2749,16 +2830,8 @@ static void convert_to_24(dib_info *dst, const dib_info *src, const RECT *src_re
         {
             for(y = src_rect->top; y < src_rect->bottom; y++)
             {
-                dst_pixel = dst_start;
-                src_pixel = src_start;
-                for(x = src_rect->left; x < src_rect->right; x++)
-                {
-                    src_val = *src_pixel++;
-                    *dst_pixel++ =  src_val        & 0xff;
-                    *dst_pixel++ = (src_val >>  8) & 0xff;
-                    *dst_pixel++ = (src_val >> 16) & 0xff;
-                }
-                if(pad_size) memset(dst_pixel, 0, pad_size);
+                convert_row_8888_to_888(dst_start, src_start, src_rect->right - src_rect->left);
+                if(pad_size) memset(dst_start + (src_rect->right - src_rect->left) * 3, 0, pad_size);
                 dst_start += dst->stride;
                 src_start += src->stride / 4;
             }
@@ -2994,16 +3067,9 @@ static void convert_to_555(dib_info *dst, const dib_info *src, const RECT *src_r
         {
             for(y = src_rect->top; y < src_rect->bottom; y++)
             {
-                dst_pixel = dst_start;
-                src_pixel = src_start;
-                for(x = src_rect->left; x < src_rect->right; x++)
-                {
-                    src_val = *src_pixel++;
-                    *dst_pixel++ = ((src_val >> 9) & 0x7c00) |
-                                   ((src_val >> 6) & 0x03e0) |
-                                   ((src_val >> 3) & 0x001f);
-                }
-                if(pad_size) memset(dst_pixel, 0, pad_size);
+                convert_row_8888_to_16(dst_start, src_start, src_rect->right - src_rect->left,
+                                       9, 0x7c00, 6, 0x03e0, 3, 0x001f);
+                if(pad_size) memset(dst_start + (src_rect->right - src_rect->left), 0, pad_size);
                 dst_start += dst->stride / 2;
                 src_start += src->stride / 4;
             }
@@ -3245,7 +3311,19 @@ static void convert_to_16(dib_info *dst, const dib_info *src, const RECT *src_re
     {
         DWORD *src_start = get_pixel_ptr_32(src, src_rect->left, src_rect->top), *src_pixel;
 
-        if(src->funcs == &funcs_8888)
+        if(src->funcs == &funcs_8888 && dst->red_mask == 0xf800 && dst->green_mask == 0x07e0 &&
+           dst->blue_mask == 0x001f)
+        {
+            for(y = src_rect->top; y < src_rect->bottom; y++)
+            {
+                convert_row_8888_to_16(dst_start, src_start, src_rect->right - src_rect->left,
+                                       8, 0xf800, 5, 0x07e0, 3, 0x001f);
+                if(pad_size) memset(dst_start + (src_rect->right - src_rect->left), 0, pad_size);
+                dst_start += dst->stride / 2;
+                src_start += src->stride / 4;
+            }
+        }
+        else if(src->funcs == &funcs_8888)
         {
             for(y = src_rect->top; y < src_rect->bottom; y++)
             {
@@ -4652,6 +4730,40 @@ static inline DWORD blend_argb( DWORD dst, DWORD src )
             (alpha + ((BYTE)(dst >> 24) * (255 - alpha) + 127) / 255) << 24);
 }
 
+/* same as blend_argb() for a row of pixels, four at a time if possible */
+static void blend_argb_row( DWORD *dst, const DWORD *src, int len )
+{
+    int x = 0;
+
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i mask = _mm_set1_epi16( 0xff );
+    const __m128i round = _mm_set1_epi16( 127 );
+    const __m128i div255 = _mm_set1_epi16( (short)0x8081 );  /* (x * 0x8081) >> 23 == x / 255 */
+
+    for (; x + 4 <= len; x += 4)
+    {
+        __m128i s = _mm_loadu_si128( (const __m128i *)(src + x) );
+        __m128i d = _mm_loadu_si128( (const __m128i *)(dst + x) );
+        __m128i s_lo = _mm_unpacklo_epi8( s, zero ), s_hi = _mm_unpackhi_epi8( s, zero );
+        __m128i d_lo = _mm_unpacklo_epi8( d, zero ), d_hi = _mm_unpackhi_epi8( d, zero );
+        __m128i a_lo = _mm_shufflehi_epi16( _mm_shufflelo_epi16( s_lo, 0xff ), 0xff );
+        __m128i a_hi = _mm_shufflehi_epi16( _mm_shufflelo_epi16( s_hi, 0xff ), 0xff );
+
+        d_lo = _mm_add_epi16( _mm_mullo_epi16( d_lo, _mm_sub_epi16( mask, a_lo )), round );
+        d_hi = _mm_add_epi16( _mm_mullo_epi16( d_hi, _mm_sub_epi16( mask, a_hi )), round );
+        s_lo = _mm_add_epi16( s_lo, _mm_srli_epi16( _mm_mulhi_epu16( d_lo, div255 ), 7 ));
+        s_hi = _mm_add_epi16( s_hi, _mm_srli_epi16( _mm_mulhi_epu16( d_hi, div255 ), 7 ));
+
+        /* channels that overflow carry into the next one, like in blend_argb() */
+        d = _mm_slli_epi32( _mm_packus_epi16( _mm_srli_epi16( s_lo, 8 ), _mm_srli_epi16( s_hi, 8 )), 8 );
+        s = _mm_packus_epi16( _mm_and_si128( s_lo, mask ), _mm_and_si128( s_hi, mask ));
+        _mm_storeu_si128( (__m128i *)(dst + x), _mm_or_si128( s, d ));
+    }
+#endif
+    for (; x < len; x++) dst[x] = blend_argb( dst[x], src[x] );
+}
+
 static inline DWORD blend_argb_alpha( DWORD dst, DWORD src, DWORD alpha )
 {
     BYTE b = ((BYTE)src         * alpha + 127) / 255;
@@ -4696,8 +4808,7 @@ static void blend_rects_8888(const dib_info *dst, int num, const RECT *rc,
         {
             if (blend.SourceConstantAlpha == 255)
                 for (y = rc->top; y < rc->bottom; y++, dst_ptr += dst->stride / 4, src_ptr += src->stride / 4)
-                    for (x = 0; x < rc->right - rc->left; x++)
-                        dst_ptr[x] = blend_argb( dst_ptr[x], src_ptr[x] );
+                    blend_argb_row( dst_ptr, src_ptr, rc->right - rc->left );
             else
                 for (y = rc->top; y < rc->bottom; y++, dst_ptr += dst->stride / 4, src_ptr += src->stride / 4)
                     for (x = 0; x < rc->right - rc->left; x++)
@@ -6139,11 +6250,37 @@ static void draw_glyph_8888( const dib_info *dib, const RECT *rect, const dib_in
     DWORD *dst_ptr = get_pixel_ptr_32( dib, rect->left, rect->top );
     const BYTE *glyph_ptr = get_pixel_ptr_8( glyph, origin->x, origin->y );
     int x, y;
+#ifdef __SSE2__
+    const __m128i one = _mm_set1_epi8( 1 ), sixteen = _mm_set1_epi8( 16 );
+    const __m128i text = _mm_set1_epi32( text_pixel );
+#endif
 
     for (y = rect->top; y < rect->bottom; y++)
     {
         for (x = 0; x < rect->right - rect->left; x++)
         {
+#ifdef __SSE2__
+            /* skip transparent runs and fill opaque runs 16 pixels at a time */
+            if (!(x % 16) && x + 16 <= rect->right - rect->left)
+            {
+                __m128i val = _mm_loadu_si128( (const __m128i *)(glyph_ptr + x) );
+
+                if (_mm_movemask_epi8( _mm_cmpeq_epi8( _mm_max_epu8( val, one ), one )) == 0xffff)
+                {
+                    x += 15;
+                    continue;
+                }
+                if (_mm_movemask_epi8( _mm_cmpeq_epi8( _mm_min_epu8( val, sixteen ), sixteen )) == 0xffff)
+                {
+                    _mm_storeu_si128( (__m128i *)(dst_ptr + x), text );
+                    _mm_storeu_si128( (__m128i *)(dst_ptr + x + 4), text );
+                    _mm_storeu_si128( (__m128i *)(dst_ptr + x + 8), text );
+                    _mm_storeu_si128( (__m128i *)(dst_ptr + x + 12), text );
+                    x += 15;
+                    continue;
+                }
+            }
+#endif
             if (glyph_ptr[x] <= 1) continue;
             if (glyph_ptr[x] >= 16) { dst_ptr[x] = text_pixel; continue; }
             dst_ptr[x] = aa_rgb( dst_ptr[x] >> 16, dst_ptr[x] >> 8, dst_ptr[x], text_pixel, ranges + glyph_ptr[x] );
@@ -7455,12 +7592,23 @@ static BYTE bilinear_interpolate( BYTE c00, BYTE c01, BYTE c10, BYTE c11, float
                                linear_interpolate( c10, c11, dx ), dy );
 }
 
-static void calc_halftone_params( const struct bitblt_coords *dst, const struct bitblt_coords *src,
-                                  RECT *dst_rect, RECT *src_rect, int *src_start_x,
-                                  int *src_start_y, float *src_inc_x, float *src_inc_y )
+struct halftone_coord
 {
-    int src_width, src_height, dst_width, dst_height;
+    int   x0;  /* left source column */
+    int   x1;  /* right source column */
+    float dx;  /* weight of the right column */
+};
+
+/* compute the source rectangles and the source columns and weights of each destination column,
+ * which are the same for every row */
+static struct halftone_coord *calc_halftone_params( const struct bitblt_coords *dst, const struct bitblt_coords *src,
+                                                    RECT *dst_rect, RECT *src_rect, int *src_start_y,
+                                                    float *src_inc_y )
+{
+    int i, src_start_x, src_width, src_height, dst_width, dst_height;
     BOOL mirrored_x, mirrored_y;
+    struct halftone_coord *cols;
+    float src_inc_x, float_x;
 
     get_bounding_rect( src_rect, src->x, src->y, src->width, src->height );
     get_bounding_rect( dst_rect, dst->x, dst->y, dst->width, dst->height );
@@ -7475,26 +7623,39 @@ static void calc_halftone_params( const struct bitblt_coords *dst, const struct
 
     mirrored_x = (dst->width < 0) != (src->width < 0);
     mirrored_y = (dst->height < 0) != (src->height < 0);
-    *src_start_x = mirrored_x ? src_rect->right - 1 : src_rect->left;
+    src_start_x = mirrored_x ? src_rect->right - 1 : src_rect->left;
     *src_start_y = mirrored_y ? src_rect->bottom - 1 : src_rect->top;
-    *src_inc_x = mirrored_x ? -(float)src_width / dst_width : (float)src_width / dst_width;
+    src_inc_x = mirrored_x ? -(float)src_width / dst_width : (float)src_width / dst_width;
     *src_inc_y = mirrored_y ? -(float)src_height / dst_height : (float)src_height / dst_height;
+
+    if (!(cols = malloc( max( dst_width, 1 ) * sizeof(*cols) ))) return NULL;
+
+    float_x = src_start_x;
+    for (i = 0; i < dst_width; i++)
+    {
+        float_x = clampf( float_x, src_rect->left, src_rect->right - 1 );
+        cols[i].x0 = float_x;
+        cols[i].x1 = clamp( cols[i].x0 + 1, src_rect->left, src_rect->right - 1 );
+        cols[i].dx = float_x - cols[i].x0;
+        float_x += src_inc_x;
+    }
+    return cols;
 }
 
-static void halftone_888( const dib_info *dst_dib, const struct bitblt_coords *dst,
+static BOOL halftone_888( const dib_info *dst_dib, const struct bitblt_coords *dst,
                           const dib_info *src_dib, const struct bitblt_coords *src )
 {
-    int src_start_x, src_start_y, src_ptr_dy, dst_x, dst_y, x0, x1, y0, y1;
+    int src_start_y, src_ptr_dy, dst_x, dst_y, x0, x1, y0, y1;
     DWORD *dst_ptr, *src_ptr, *c00_ptr, *c01_ptr, *c10_ptr, *c11_ptr;
-    float src_inc_x, src_inc_y, float_x, float_y, dx, dy;
+    float src_inc_y, float_y, dx, dy;
     BYTE c00_r, c01_r, c10_r, c11_r;
     BYTE c00_g, c01_g, c10_g, c11_g;
     BYTE c00_b, c01_b, c10_b, c11_b;
+    struct halftone_coord *cols;
     RECT dst_rect, src_rect;
     BYTE r, g, b;
 
-    calc_halftone_params( dst, src, &dst_rect, &src_rect, &src_start_x, &src_start_y, &src_inc_x,
-                          &src_inc_y );
+    if (!(cols = calc_halftone_params( dst, src, &dst_rect, &src_rect, &src_start_y, &src_inc_y ))) return FALSE;
 
     float_y = src_start_y;
     dst_ptr = get_pixel_ptr_32( dst_dib, dst_rect.left, dst_rect.top );
@@ -7505,15 +7666,13 @@ static void halftone_888( const dib_info *dst_dib, const struct bitblt_coords *d
         y1 = clamp( y0 + 1, src_rect.top, src_rect.bottom - 1 );
         dy = float_y - y0;
 
-        float_x = src_start_x;
         src_ptr = get_pixel_ptr_32( src_dib, 0, y0 );
         src_ptr_dy = (y1 - y0) * src_dib->stride / 4;
         for (dst_x = 0; dst_x < dst_rect.right - dst_rect.left; ++dst_x)
         {
-            float_x = clampf( float_x, src_rect.left, src_rect.right - 1 );
-            x0 = float_x;
-            x1 = clamp( x0 + 1, src_rect.left, src_rect.right - 1 );
-            dx = float_x - x0;
+            x0 = cols[dst_x].x0;
+            x1 = cols[dst_x].x1;
+            dx = cols[dst_x].dx;
 
             c00_ptr = src_ptr + x0;
             c01_ptr = src_ptr + x1;
@@ -7535,29 +7694,30 @@ static void halftone_888( const dib_info *dst_dib, const struct bitblt_coords *d
             g = bilinear_interpolate( c00_g, c01_g, c10_g, c11_g, dx, dy );
             b = bilinear_interpolate( c00_b, c01_b, c10_b, c11_b, dx, dy );
             dst_ptr[dst_x] = ((r << 16) & 0xff0000) | ((g << 8) & 0x00ff00) | (b & 0x0000ff);
-
-            float_x += src_inc_x;
         }
 
         dst_ptr += dst_dib->stride / 4;
         float_y += src_inc_y;
     }
+
+    free( cols );
+    return TRUE;
 }
 
-static void halftone_32( const dib_info *dst_dib, const struct bitblt_coords *dst,
+static BOOL halftone_32( const dib_info *dst_dib, const struct bitblt_coords *dst,
                          const dib_info *src_dib, const struct bitblt_coords *src )
 {
-    int src_start_x, src_start_y, src_ptr_dy, dst_x, dst_y, x0, x1, y0, y1;
+    int src_start_y, src_ptr_dy, dst_x, dst_y, x0, x1, y0, y1;
     DWORD *dst_ptr, *src_ptr, *c00_ptr, *c01_ptr, *c10_ptr, *c11_ptr;
-    float src_inc_x, src_inc_y, float_x, float_y, dx, dy;
+    float src_inc_y, float_y, dx, dy;
     BYTE c00_r, c01_r, c10_r, c11_r;
     BYTE c00_g, c01_g, c10_g, c11_g;
     BYTE c00_b, c01_b, c10_b, c11_b;
+    struct halftone_coord *cols;
     RECT dst_rect, src_rect;
     BYTE r, g, b;
 
-    calc_halftone_params( dst, src, &dst_rect, &src_rect, &src_start_x, &src_start_y, &src_inc_x,
-                          &src_inc_y );
+    if (!(cols = calc_halftone_params( dst, src, &dst_rect, &src_rect, &src_start_y, &src_inc_y ))) return FALSE;
 
     float_y = src_start_y;
     dst_ptr = get_pixel_ptr_32( dst_dib, dst_rect.left, dst_rect.top );
@@ -7568,15 +7728,13 @@ static void halftone_32( const dib_info *dst_dib, const struct bitblt_coords *ds
         y1 = clamp( y0 + 1, src_rect.top, src_rect.bottom - 1 );
         dy = float_y - y0;
 
-        float_x = src_start_x;
         src_ptr = get_pixel_ptr_32( src_dib, 0, y0 );
         src_ptr_dy = (y1 - y0) * src_dib->stride / 4;
         for (dst_x = 0; dst_x < dst_rect.right - dst_rect.left; ++dst_x)
         {
-            float_x = clampf( float_x, src_rect.left, src_rect.right - 1 );
-            x0 = float_x;
-            x1 = clamp( x0 + 1, src_rect.left, src_rect.right - 1 );
-            dx = float_x - x0;
+            x0 = cols[dst_x].x0;
+            x1 = cols[dst_x].x1;
+            dx = cols[dst_x].dx;
 
             c00_ptr = src_ptr + x0;
             c01_ptr = src_ptr + x1;
@@ -7598,29 +7756,30 @@ static void halftone_32( const dib_info *dst_dib, const struct bitblt_coords *ds
             g = bilinear_interpolate( c00_g, c01_g, c10_g, c11_g, dx, dy );
             b = bilinear_interpolate( c00_b, c01_b, c10_b, c11_b, dx, dy );
             dst_ptr[dst_x] = rgb_to_pixel_masks( dst_dib, r, g, b );
-
-            float_x += src_inc_x;
         }
 
         dst_ptr += dst_dib->stride / 4;
         float_y += src_inc_y;
     }
+
+    free( cols );
+    return TRUE;
 }
 
-static void halftone_24( const dib_info *dst_dib, const struct bitblt_coords *dst,
+static BOOL halftone_24( const dib_info *dst_dib, const struct bitblt_coords *dst,
                          const dib_info *src_dib, const struct bitblt_coords *src )
 {
-    int src_start_x, src_start_y, src_ptr_dy, dst_x, dst_y, x0, x1, y0, y1;
+    int src_start_y, src_ptr_dy, dst_x, dst_y, x0, x1, y0, y1;
     BYTE *dst_ptr, *src_ptr, *c00_ptr, *c01_ptr, *c10_ptr, *c11_ptr;
-    float src_inc_x, src_inc_y, float_x, float_y, dx, dy;
+    float src_inc_y, float_y, dx, dy;
     BYTE c00_r, c01_r, c10_r, c11_r;
     BYTE c00_g, c01_g, c10_g, c11_g;
     BYTE c00_b, c01_b, c10_b, c11_b;
+    struct halftone_coord *cols;
     RECT dst_rect, src_rect;
     BYTE r, g, b;
 
-    calc_halftone_params( dst, src, &dst_rect, &src_rect, &src_start_x, &src_start_y, &src_inc_x,
-                          &src_inc_y );
+    if (!(cols = calc_halftone_params( dst, src, &dst_rect, &src_rect, &src_start_y, &src_inc_y ))) return FALSE;
 
     float_y = src_start_y;
     dst_ptr = get_pixel_ptr_24( dst_dib, dst_rect.left, dst_rect.top );
@@ -7631,15 +7790,13 @@ static void halftone_24( const dib_info *dst_dib, const struct bitblt_coords *ds
         y1 = clamp( y0 + 1, src_rect.top, src_rect.bottom - 1 );
         dy = float_y - y0;
 
-        float_x = src_start_x;
         src_ptr = get_pixel_ptr_24( src_dib, 0, y0 );
         src_ptr_dy = (y1 - y0) * src_dib->stride;
         for (dst_x = 0; dst_x < dst_rect.right - dst_rect.left; ++dst_x)
         {
-            float_x = clampf( float_x, src_rect.left, src_rect.right - 1 );
-            x0 = float_x;
-            x1 = clamp( x0 + 1, src_rect.left, src_rect.right - 1 );
-            dx = float_x - x0;
+            x0 = cols[dst_x].x0;
+            x1 = cols[dst_x].x1;
+            dx = cols[dst_x].dx;
 
             c00_ptr = src_ptr + x0 * 3;
             c01_ptr = src_ptr + x1 * 3;
@@ -7663,29 +7820,30 @@ static void halftone_24( const dib_info *dst_dib, const struct bitblt_coords *ds
             dst_ptr[dst_x * 3] = b;
             dst_ptr[dst_x * 3 + 1] = g;
             dst_ptr[dst_x * 3 + 2] = r;
-
-            float_x += src_inc_x;
         }
 
         dst_ptr += dst_dib->stride;
         float_y += src_inc_y;
     }
+
+    free( cols );
+    return TRUE;
 }
 
-static void halftone_555( const dib_info *dst_dib, const struct bitblt_coords *dst,
+static BOOL halftone_555( const dib_info *dst_dib, const struct bitblt_coords *dst,
                           const dib_info *src_dib, const struct bitblt_coords *src )
 {
-    int src_start_x, src_start_y, src_ptr_dy, dst_x, dst_y, x0, x1, y0, y1;
+    int src_start_y, src_ptr_dy, dst_x, dst_y, x0, x1, y0, y1;
     WORD *dst_ptr, *src_ptr, *c00_ptr, *c01_ptr, *c10_ptr, *c11_ptr;
-    float src_inc_x, src_inc_y, float_x, float_y, dx, dy;
+    float src_inc_y, float_y, dx, dy;
     BYTE c00_r, c01_r, c10_r, c11_r;
     BYTE c00_g, c01_g, c10_g, c11_g;
     BYTE c00_b, c01_b, c10_b, c11_b;
+    struct halftone_coord *cols;
     RECT dst_rect, src_rect;
     BYTE r, g, b;
 
-    calc_halftone_params( dst, src, &dst_rect, &src_rect, &src_start_x, &src_start_y, &src_inc_x,
-                          &src_inc_y );
+    if (!(cols = calc_halftone_params( dst, src, &dst_rect, &src_rect, &src_start_y, &src_inc_y ))) return FALSE;
 
     float_y = src_start_y;
     dst_ptr = get_pixel_ptr_16( dst_dib, dst_rect.left, dst_rect.top );
@@ -7696,15 +7854,13 @@ static void halftone_555( const dib_info *dst_dib, const struct bitblt_coords *d
         y1 = clamp( y0 + 1, src_rect.top, src_rect.bottom - 1 );
         dy = float_y - y0;
 
-        float_x = src_start_x;
         src_ptr = get_pixel_ptr_16( src_dib, 0, y0 );
         src_ptr_dy = (y1 - y0) * src_dib->stride / 2;
         for (dst_x = 0; dst_x < dst_rect.right - dst_rect.left; ++dst_x)
         {
-            float_x = clampf( float_x, src_rect.left, src_rect.right - 1 );
-            x0 = float_x;
-            x1 = clamp( x0 + 1, src_rect.left, src_rect.right - 1 );
-            dx = float_x - x0;
+            x0 = cols[dst_x].x0;
+            x1 = cols[dst_x].x1;
+            dx = cols[dst_x].dx;
 
             c00_ptr = src_ptr + x0;
             c01_ptr = src_ptr + x1;
@@ -7726,29 +7882,30 @@ static void halftone_555( const dib_info *dst_dib, const struct bitblt_coords *d
             g = bilinear_interpolate( c00_g, c01_g, c10_g, c11_g, dx, dy );
             b = bilinear_interpolate( c00_b, c01_b, c10_b, c11_b, dx, dy );
             dst_ptr[dst_x] = ((r << 7) & 0x7c00) | ((g << 2) & 0x03e0) | ((b >> 3) & 0x001f);
-
-            float_x += src_inc_x;
         }
 
         dst_ptr += dst_dib->stride / 2;
         float_y += src_inc_y;
     }
+
+    free( cols );
+    return TRUE;
 }
 
-static void halftone_16( const dib_info *dst_dib, const struct bitblt_coords *dst,
+static BOOL halftone_16( const dib_info *dst_dib, const struct bitblt_coords *dst,
                          const dib_info *src_dib, const struct bitblt_coords *src )
 {
-    int src_start_x, src_start_y, src_ptr_dy, dst_x, dst_y, x0, x1, y0, y1;
+    int src_start_y, src_ptr_dy, dst_x, dst_y, x0, x1, y0, y1;
     WORD *dst_ptr, *src_ptr, *c00_ptr, *c01_ptr, *c10_ptr, *c11_ptr;
-    float src_inc_x, src_inc_y, float_x, float_y, dx, dy;
+    float src_inc_y, float_y, dx, dy;
     BYTE c00_r, c01_r, c10_r, c11_r;
     BYTE c00_g, c01_g, c10_g, c11_g;
     BYTE c00_b, c01_b, c10_b, c11_b;
+    struct halftone_coord *cols;
     RECT dst_rect, src_rect;
     BYTE r, g, b;
 
-    calc_halftone_params( dst, src, &dst_rect, &src_rect, &src_start_x, &src_start_y, &src_inc_x,
-                          &src_inc_y );
+    if (!(cols = calc_halftone_params( dst, src, &dst_rect, &src_rect, &src_start_y, &src_inc_y ))) return FALSE;
 
     float_y = src_start_y;
     dst_ptr = get_pixel_ptr_16( dst_dib, dst_rect.left, dst_rect.top );
@@ -7759,15 +7916,13 @@ static void halftone_16( const dib_info *dst_dib, const struct bitblt_coords *ds
         y1 = clamp( y0 + 1, src_rect.top, src_rect.bottom - 1 );
         dy = float_y - y0;
 
-        float_x = src_start_x;
         src_ptr = get_pixel_ptr_16( src_dib, 0, y0 );
         src_ptr_dy = (y1 - y0) * src_dib->stride / 2;
         for (dst_x = 0; dst_x < dst_rect.right - dst_rect.left; ++dst_x)
         {
-            float_x = clampf( float_x, src_rect.left, src_rect.right - 1 );
-            x0 = float_x;
-            x1 = clamp( x0 + 1, src_rect.left, src_rect.right - 1 );
-            dx = float_x - x0;
+            x0 = cols[dst_x].x0;
+            x1 = cols[dst_x].x1;
+            dx = cols[dst_x].dx;
 
             c00_ptr = src_ptr + x0;
             c01_ptr = src_ptr + x1;
@@ -7789,28 +7944,29 @@ static void halftone_16( const dib_info *dst_dib, const struct bitblt_coords *ds
             g = bilinear_interpolate( c00_g, c01_g, c10_g, c11_g, dx, dy );
             b = bilinear_interpolate( c00_b, c01_b, c10_b, c11_b, dx, dy );
             dst_ptr[dst_x] = rgb_to_pixel_masks( dst_dib, r, g, b );
-
-            float_x += src_inc_x;
         }
 
         dst_ptr += dst_dib->stride / 2;
         float_y += src_inc_y;
     }
+
+    free( cols );
+    return TRUE;
 }
 
-static void halftone_8( const dib_info *dst_dib, const struct bitblt_coords *dst,
+static BOOL halftone_8( const dib_info *dst_dib, const struct bitblt_coords *dst,
                         const dib_info *src_dib, const struct bitblt_coords *src )
 {
-    int src_start_x, src_start_y, src_ptr_dy, dst_x, dst_y, x0, x1, y0, y1;
+    int src_start_y, src_ptr_dy, dst_x, dst_y, x0, x1, y0, y1;
     BYTE *dst_ptr, *src_ptr, *c00_ptr, *c01_ptr, *c10_ptr, *c11_ptr;
     RGBQUAD c00_rgb, c01_rgb, c10_rgb, c11_rgb, zero_rgb = {0};
-    float src_inc_x, src_inc_y, float_x, float_y, dx, dy;
+    float src_inc_y, float_y, dx, dy;
     const RGBQUAD *src_clr_table;
+    struct halftone_coord *cols;
     RECT dst_rect, src_rect;
     BYTE r, g, b;
 
-    calc_halftone_params( dst, src, &dst_rect, &src_rect, &src_start_x, &src_start_y, &src_inc_x,
-                          &src_inc_y );
+    if (!(cols = calc_halftone_params( dst, src, &dst_rect, &src_rect, &src_start_y, &src_inc_y ))) return FALSE;
 
     float_y = src_start_y;
     src_clr_table = get_dib_color_table( src_dib );
@@ -7822,15 +7978,13 @@ static void halftone_8( const dib_info *dst_dib, const struct bitblt_coords *dst
         y1 = clamp( y0 + 1, src_rect.top, src_rect.bottom - 1 );
         dy = float_y - y0;
 
-        float_x = src_start_x;
         src_ptr = get_pixel_ptr_8( src_dib, 0, y0 );
         src_ptr_dy = (y1 - y0) * src_dib->stride;
         for (dst_x = 0; dst_x < dst_rect.right - dst_rect.left; ++dst_x)
         {
-            float_x = clampf( float_x, src_rect.left, src_rect.right - 1 );
-            x0 = float_x;
-            x1 = clamp( x0 + 1, src_rect.left, src_rect.right - 1 );
-            dx = float_x - x0;
+            x0 = cols[dst_x].x0;
+            x1 = cols[dst_x].x1;
+            dx = cols[dst_x].dx;
 
             c00_ptr = src_ptr + x0;
             c01_ptr = src_ptr + x1;
@@ -7853,28 +8007,29 @@ static void halftone_8( const dib_info *dst_dib, const struct bitblt_coords *dst
                 b = 0;
             }
             dst_ptr[dst_x] = rgb_to_pixel_colortable( dst_dib, r, g, b );
-
-            float_x += src_inc_x;
         }
 
         dst_ptr += dst_dib->stride;
         float_y += src_inc_y;
     }
+
+    free( cols );
+    return TRUE;
 }
 
-static void halftone_4( const dib_info *dst_dib, const struct bitblt_coords *dst,
+static BOOL halftone_4( const dib_info *dst_dib, const struct bitblt_coords *dst,
                         const dib_info *src_dib, const struct bitblt_coords *src )
 {
     BYTE *dst_col_ptr, *dst_ptr, *src_ptr, *c00_ptr, *c01_ptr, *c10_ptr, *c11_ptr;
-    int src_start_x, src_start_y, src_ptr_dy, dst_x, dst_y, x0, x1, y0, y1;
+    int src_start_y, src_ptr_dy, dst_x, dst_y, x0, x1, y0, y1;
     RGBQUAD c00_rgb, c01_rgb, c10_rgb, c11_rgb, zero_rgb = {0};
-    float src_inc_x, src_inc_y, float_x, float_y, dx, dy;
+    float src_inc_y, float_y, dx, dy;
     BYTE r, g, b, val, c00, c01, c10, c11;
     const RGBQUAD *src_clr_table;
+    struct halftone_coord *cols;
     RECT dst_rect, src_rect;
 
-    calc_halftone_params( dst, src, &dst_rect, &src_rect, &src_start_x, &src_start_y, &src_inc_x,
-                          &src_inc_y );
+    if (!(cols = calc_halftone_params( dst, src, &dst_rect, &src_rect, &src_start_y, &src_inc_y ))) return FALSE;
 
     float_y = src_start_y;
     src_clr_table = get_dib_color_table( src_dib );
@@ -7886,15 +8041,13 @@ static void halftone_4( const dib_info *dst_dib, const struct bitblt_coords *dst
         y1 = clamp( y0 + 1, src_rect.top, src_rect.bottom - 1 );
         dy = float_y - y0;
 
-        float_x = src_start_x;
         src_ptr = (BYTE *)src_dib->bits.ptr + (src_dib->rect.top + y0) * src_dib->stride;
         src_ptr_dy = (y1 - y0) * src_dib->stride;
         for (dst_x = dst_rect.left; dst_x < dst_rect.right; ++dst_x)
         {
-            float_x = clampf( float_x, src_rect.left, src_rect.right - 1 );
-            x0 = float_x;
-            x1 = clamp( x0 + 1, src_rect.left, src_rect.right - 1 );
-            dx = float_x - x0;
+            x0 = cols[dst_x - dst_rect.left].x0;
+            x1 = cols[dst_x - dst_rect.left].x1;
+            dx = cols[dst_x - dst_rect.left].dx;
 
             c00_ptr = src_ptr + (src_dib->rect.left + x0) / 2;
             c01_ptr = src_ptr + (src_dib->rect.left + x1) / 2;
@@ -7944,30 +8097,31 @@ static void halftone_4( const dib_info *dst_dib, const struct bitblt_coords *dst
                 *dst_ptr = (val & 0x0f) | (*dst_ptr & 0xf0);
             else
                 *dst_ptr = (val << 4) & 0xf0;
-
-            float_x += src_inc_x;
         }
 
         dst_col_ptr += dst_dib->stride;
         float_y += src_inc_y;
     }
+
+    free( cols );
+    return TRUE;
 }
 
-static void halftone_1( const dib_info *dst_dib, const struct bitblt_coords *dst,
+static BOOL halftone_1( const dib_info *dst_dib, const struct bitblt_coords *dst,
                         const dib_info *src_dib, const struct bitblt_coords *src )
 {
-    int src_start_x, src_start_y, src_ptr_dy, dst_x, dst_y, x0, x1, y0, y1, bit_pos;
+    int src_start_y, src_ptr_dy, dst_x, dst_y, x0, x1, y0, y1, bit_pos;
     BYTE *dst_col_ptr, *dst_ptr, *src_ptr, *c00_ptr, *c01_ptr, *c10_ptr, *c11_ptr;
     RGBQUAD c00_rgb, c01_rgb, c10_rgb, c11_rgb, zero_rgb = {0};
-    float src_inc_x, src_inc_y, float_x, float_y, dx, dy;
+    float src_inc_y, float_y, dx, dy;
     BYTE r, g, b, val, c00, c01, c10, c11;
     const RGBQUAD *src_clr_table;
+    struct halftone_coord *cols;
     RECT dst_rect, src_rect;
     RGBQUAD bg_entry;
     DWORD bg_pixel;
 
-    calc_halftone_params( dst, src, &dst_rect, &src_rect, &src_start_x, &src_start_y, &src_inc_x,
-                          &src_inc_y );
+    if (!(cols = calc_halftone_params( dst, src, &dst_rect, &src_rect, &src_start_y, &src_inc_y ))) return FALSE;
 
     float_y = src_start_y;
     bg_entry = *get_dib_color_table( dst_dib );
@@ -7980,15 +8134,13 @@ static void halftone_1( const dib_info *dst_dib, const struct bitblt_coords *dst
         y1 = clamp( y0 + 1, src_rect.top, src_rect.bottom - 1 );
         dy = float_y - y0;
 
-        float_x = src_start_x;
         src_ptr = (BYTE *)src_dib->bits.ptr + (src_dib->rect.top + y0) * src_dib->stride;
         src_ptr_dy = (y1 - y0) * src_dib->stride;
         for (dst_x = dst_rect.left; dst_x < dst_rect.right; ++dst_x)
         {
-            float_x = clampf( float_x, src_rect.left, src_rect.right - 1 );
-            x0 = float_x;
-            x1 = clamp( x0 + 1, src_rect.left, src_rect.right - 1 );
-            dx = float_x - x0;
+            x0 = cols[dst_x - dst_rect.left].x0;
+            x1 = cols[dst_x - dst_rect.left].x1;
+            dx = cols[dst_x - dst_rect.left].dx;
 
             c00_ptr = src_ptr + (src_dib->rect.left + x0) / 8;
             c01_ptr = src_ptr + (src_dib->rect.left + x1) / 8;
@@ -8023,18 +8175,21 @@ static void halftone_1( const dib_info *dst_dib, const struct bitblt_coords *dst
             if (bit_pos == 0)
                 *dst_ptr = 0;
             *dst_ptr = (*dst_ptr & ~pixel_masks_1[bit_pos]) | (val & pixel_masks_1[bit_pos]);
-
-            float_x += src_inc_x;
         }
 
         dst_col_ptr += dst_dib->stride;
         float_y += src_inc_y;
     }
+
+    free( cols );
+    return TRUE;
 }
 
-static void halftone_null( const dib_info *dst_dib, const struct bitblt_coords *dst,
+static BOOL halftone_null( const dib_info *dst_dib, const struct bitblt_coords *dst,
                            const dib_info *src_dib, const struct bitblt_coords *src )
-{}
+{
+    return TRUE;
+}
 
 const primitive_funcs funcs_8888 =
 {
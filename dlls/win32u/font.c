@@ -199,6 +199,8 @@ static struct font_gamma_ramp font_gamma_ramp;
 static void add_face_to_cache( struct gdi_font_face *face );
 static void remove_face_from_cache( struct gdi_font_face *face );
 
+static const WCHAR font_cache_indexW[] = {'I','n','d','e','x',0};
+
 static CPTABLEINFO utf8_cp;
 static CPTABLEINFO oem_cp;
 CPTABLEINFO ansi_cp = { 0 };
@@ -1343,8 +1345,10 @@ static void load_font_list_from_cache(void)
 static void add_face_to_cache( struct gdi_font_face *face )
 {
     HKEY hkey_family, hkey_face;
-    DWORD len, buffer[1024];
+    DWORD len, size, buffer[1024];
     struct cached_face *cached = (struct cached_face *)buffer;
+    char info_buffer[FIELD_OFFSET( KEY_VALUE_PARTIAL_INFORMATION, Data[sizeof(buffer)] )];
+    KEY_VALUE_PARTIAL_INFORMATION *info = (void *)info_buffer;
 
     if (!(hkey_family = reg_create_key( wine_fonts_cache_key, face->family->family_name,
                                         lstrlenW( face->family->family_name ) * sizeof(WCHAR),
@@ -1379,8 +1383,15 @@ static void add_face_to_cache( struct gdi_font_face *face )
     lstrcpyW( cached->full_name + len, face->file );
     len += lstrlenW( face->file ) + 1;
 
-    set_reg_value( hkey_face, face->style_name, REG_BINARY, cached,
-                   offsetof( struct cached_face, full_name[len] ));
+    size = offsetof( struct cached_face, full_name[len] );
+
+    /* processes re-adding registry fonts write back the same data, leave the index alone then */
+    if (query_reg_value( hkey_face, face->style_name, info, sizeof(info_buffer) ) != size ||
+        info->Type != REG_BINARY || memcmp( info->Data, cached, size ))
+    {
+        set_reg_value( hkey_face, face->style_name, REG_BINARY, cached, size );
+        reg_delete_value( wine_fonts_cache_key, font_cache_indexW );
+    }
 
     if (hkey_face != hkey_family) NtClose( hkey_face );
     NtClose( hkey_family );
@@ -1409,6 +1420,189 @@ static void remove_face_from_cache( struct gdi_font_face *face )
     else reg_delete_value( hkey_family, face->style_name );
 
     NtClose( hkey_family );
+    reg_delete_value( wine_fonts_cache_key, font_cache_indexW );
+}
+
+/* The whole cache is also stored packed in a single value of the cache key, so that
+ * processes starting after the first one can load it with one registry request instead
+ * of enumerating every family and face key. The index is written by the process that
+ * creates the cache and deleted as soon as a face is added or removed, in which case
+ * the keys are enumerated as before. */
+
+#define FONT_CACHE_INDEX_MAGIC  0x58444e49 /* INDX */
+
+struct font_cache_index
+{
+    DWORD magic;
+    DWORD size;       /* total size of the index */
+    DWORD count;      /* number of entries */
+    /* struct font_cache_entry entries[]; */
+};
+
+struct font_cache_entry
+{
+    DWORD size;       /* total size of the entry, DWORD aligned */
+    DWORD face_size;  /* size of the cached face data */
+    WORD  family_len; /* lengths in WCHARs including the terminating null */
+    WORD  second_len;
+    WORD  style_len;
+    WORD  scalable;
+    /* WCHAR family_name[family_len]; */
+    /* WCHAR second_name[second_len]; */
+    /* WCHAR style_name[style_len]; */
+    /* struct cached_face face;  DWORD aligned */
+};
+
+static DWORD get_font_cache_entry_size( const struct gdi_font_face *face, DWORD *face_size )
+{
+    DWORD size;
+
+    *face_size = offsetof( struct cached_face, full_name[lstrlenW( face->full_name ) + 1 +
+                                                        lstrlenW( face->file ) + 1] );
+    size = sizeof(struct font_cache_entry);
+    size += (lstrlenW( face->family->family_name ) + 1) * sizeof(WCHAR);
+    size += (lstrlenW( face->family->second_name ) + 1) * sizeof(WCHAR);
+    size += (lstrlenW( face->style_name ) + 1) * sizeof(WCHAR);
+    size = (size + 3) & ~3;
+    return (size + *face_size + 3) & ~3;
+}
+
+static void save_font_list_to_index(void)
+{
+    struct gdi_font_family *family;
+    struct gdi_font_face *face;
+    struct font_cache_index *index;
+    struct font_cache_entry *entry;
+    struct cached_face *cached;
+    DWORD size = sizeof(*index), face_size, len;
+    WCHAR *str;
+    char *ptr;
+
+    WINE_RB_FOR_EACH_ENTRY( family, &family_name_tree, struct gdi_font_family, name_entry )
+        LIST_FOR_EACH_ENTRY( face, &family->faces, struct gdi_font_face, entry )
+            if ((face->flags & ADDFONT_ADD_TO_CACHE) && face->file)
+                size += get_font_cache_entry_size( face, &face_size );
+
+    if (!(index = calloc( 1, size ))) return;
+    index->magic = FONT_CACHE_INDEX_MAGIC;
+    index->size = size;
+    ptr = (char *)(index + 1);
+
+    WINE_RB_FOR_EACH_ENTRY( family, &family_name_tree, struct gdi_font_family, name_entry )
+    {
+        LIST_FOR_EACH_ENTRY( face, &family->faces, struct gdi_font_face, entry )
+        {
+            if (!(face->flags & ADDFONT_ADD_TO_CACHE) || !face->file) continue;
+
+            entry = (struct font_cache_entry *)ptr;
+            entry->size       = get_font_cache_entry_size( face, &face_size );
+            entry->face_size  = face_size;
+            entry->family_len = lstrlenW( family->family_name ) + 1;
+            entry->second_len = lstrlenW( family->second_name ) + 1;
+            entry->style_len  = lstrlenW( face->style_name ) + 1;
+            entry->scalable   = face->scalable;
+
+            str = (WCHAR *)(entry + 1);
+            lstrcpyW( str, family->family_name );
+            str += entry->family_len;
+            lstrcpyW( str, family->second_name );
+            str += entry->second_len;
+            lstrcpyW( str, face->style_name );
+            str += entry->style_len;
+
+            cached = (struct cached_face *)(((UINT_PTR)str + 3) & ~3);
+            cached->index = face->face_index;
+            cached->flags = face->flags;
+            cached->ntmflags = face->ntmFlags;
+            cached->version = face->version;
+            cached->fs = face->fs;
+            if (!face->scalable) cached->size = face->size;
+            lstrcpyW( cached->full_name, face->full_name );
+            len = lstrlenW( face->full_name ) + 1;
+            lstrcpyW( cached->full_name + len, face->file );
+
+            ptr += entry->size;
+            index->count++;
+        }
+    }
+
+    set_reg_value( wine_fonts_cache_key, font_cache_indexW, REG_BINARY, index, size );
+    TRACE( "saved %u faces, %u bytes\n", (int)index->count, (int)size );
+    free( index );
+}
+
+static BOOL load_font_list_from_index(void)
+{
+    KEY_VALUE_PARTIAL_INFORMATION *info;
+    const struct font_cache_index *index;
+    const struct font_cache_entry *entry;
+    const struct cached_face *cached;
+    struct gdi_font_family *family;
+    struct gdi_font_face *face;
+    const WCHAR *family_name, *second_name, *style_name, *file;
+    UNICODE_STRING nameW = { sizeof(font_cache_indexW) - sizeof(WCHAR), sizeof(font_cache_indexW),
+                             (WCHAR *)font_cache_indexW };
+    DWORD size = 0, i, pos, str_size;
+
+    if (NtQueryValueKey( wine_fonts_cache_key, &nameW, KeyValuePartialInformation,
+                         NULL, 0, &size ) != STATUS_BUFFER_TOO_SMALL)
+        return FALSE;
+    if (!(info = malloc( size ))) return FALSE;
+    if ((size = query_reg_value( wine_fonts_cache_key, font_cache_indexW, info, size )) < sizeof(*index) ||
+        info->Type != REG_BINARY)
+        goto failed;
+
+    index = (const struct font_cache_index *)info->Data;
+    if (index->magic != FONT_CACHE_INDEX_MAGIC || index->size != size) goto failed;
+
+    /* validate everything first, the font list must not be left half loaded */
+    for (i = 0, pos = sizeof(*index); i < index->count; i++, pos += entry->size)
+    {
+        entry = (const struct font_cache_entry *)((const char *)index + pos);
+        if (size - pos < sizeof(*entry) || entry->size > size - pos) goto failed;
+        str_size = (entry->family_len + entry->second_len + entry->style_len) * sizeof(WCHAR);
+        if (!entry->family_len || !entry->second_len || !entry->style_len ||
+            entry->face_size <= sizeof(*cached) ||
+            ((sizeof(*entry) + str_size + 3) & ~3) + entry->face_size > entry->size)
+            goto failed;
+        family_name = (const WCHAR *)(entry + 1);
+        second_name = family_name + entry->family_len;
+        style_name = second_name + entry->second_len;
+        cached = (const struct cached_face *)(((UINT_PTR)(style_name + entry->style_len) + 3) & ~3);
+        if (family_name[entry->family_len - 1] || second_name[entry->second_len - 1] ||
+            style_name[entry->style_len - 1] ||
+            ((const WCHAR *)((const char *)cached + entry->face_size))[-1])
+            goto failed;
+    }
+    if (pos != size) goto failed;
+
+    for (i = 0, pos = sizeof(*index); i < index->count; i++, pos += entry->size)
+    {
+        entry = (const struct font_cache_entry *)((const char *)index + pos);
+        family_name = (const WCHAR *)(entry + 1);
+        second_name = family_name + entry->family_len;
+        style_name = second_name + entry->second_len;
+        cached = (const struct cached_face *)(((UINT_PTR)(style_name + entry->style_len) + 3) & ~3);
+        file = cached->full_name + lstrlenW( cached->full_name ) + 1;
+
+        if ((family = find_family_from_name( family_name ))) family->refcount++;
+        else if (!(family = create_family( family_name, second_name ))) continue;
+
+        if ((face = create_face( family, style_name, cached->full_name, file, NULL, 0,
+                                 cached->index, cached->fs, cached->ntmflags, cached->version,
+                                 cached->flags, entry->scalable ? NULL : &cached->size )))
+            release_face( face );
+        release_family( family );
+    }
+
+    TRACE( "loaded %u faces from index\n", (int)index->count );
+    free( info );
+    return TRUE;
+
+failed:
+    WARN( "invalid font cache index\n" );
+    free( info );
+    return FALSE;
 }
 
 /* font links */
@@ -6825,6 +7019,7 @@ UINT font_init(void)
     {
         load_registry_fonts();
         update_external_font_keys();
+        save_font_list_to_index();
     }
 
     NtReleaseMutant( mutex, NULL );
@@ -6832,7 +7027,7 @@ UINT font_init(void)
     if (disposition != REG_CREATED_NEW_KEY)
     {
         load_registry_fonts();
-        load_font_list_from_cache();
+        if (!load_font_list_from_index()) load_font_list_from_cache();
     }
 
     reorder_font_list();
@@ -833,6 +833,7 @@ DWORD WINAPI NtUserGetQueueStatus( UINT flags )
     }
 
     check_for_events( flags );
+    flush_local_posted_messages();
 
     SERVER_START_REQ( get_queue_status )
     {
@@ -1883,6 +1883,161 @@ static BOOL process_hardware_message( MSG *msg, UINT hw_id, const struct hardwar
     return ret;
 }
 
+/* Messages that a thread posts to itself are kept in a client-side queue
+ * as long as the server queue doesn't hold any posted message, which keeps
+ * them ordered before anything posted later through the server. They are
+ * moved to the server queue before waiting on it. */
+
+#define LOCAL_POST_QUEUE_SIZE 256
+
+struct local_post_queue
+{
+    unsigned int head;                          /* index of the oldest message */
+    unsigned int count;                         /* number of queued messages */
+    unsigned int seen;                          /* number of oldest messages already seen by a peek */
+    MSG          msgs[LOCAL_POST_QUEUE_SIZE];   /* ring buffer of messages */
+};
+
+static inline MSG *get_local_posted_message( struct local_post_queue *queue, unsigned int index )
+{
+    return &queue->msgs[(queue->head + index) % LOCAL_POST_QUEUE_SIZE];
+}
+
+/***********************************************************************
+ *           post_local_message
+ *
+ * Try to queue a message posted to the current thread without a server call.
+ */
+static BOOL post_local_message( const struct send_message_info *info )
+{
+    struct user_thread_info *thread_info = get_user_thread_info();
+    struct local_post_queue *queue = thread_info->local_posted;
+    volatile struct queue_shared_memory *shared;
+    volatile struct desktop_shared_memory *desktop;
+    BOOL empty = FALSE;
+    MSG *msg;
+
+    if (info->dest_tid != GetCurrentThreadId()) return FALSE;
+    if (info->msg & 0x80000000) return FALSE;  /* internal message */
+    if (info->msg >= WM_DDE_FIRST && info->msg <= WM_DDE_LAST) return FALSE;
+    if (info->msg == WM_HOTKEY) return FALSE;
+    if (queue && queue->count == LOCAL_POST_QUEUE_SIZE) return FALSE;
+    if (!(shared = get_queue_shared_memory())) return FALSE;
+
+    SHARED_READ_BEGIN( &shared->seq )
+    {
+        empty = shared->created && !(shared->wake_bits & QS_POSTMESSAGE);
+    }
+    SHARED_READ_END( &shared->seq );
+    if (!empty) return FALSE;
+
+    if (!queue && !(queue = thread_info->local_posted = calloc( 1, sizeof(*queue) ))) return FALSE;
+
+    msg = get_local_posted_message( queue, queue->count++ );
+    msg->hwnd    = get_full_window_handle( info->hwnd );
+    msg->message = info->msg;
+    msg->wParam  = info->wparam;
+    msg->lParam  = info->lparam;
+    msg->time    = NtGetTickCount();
+    msg->pt.x    = msg->pt.y = 0;
+    if ((desktop = get_desktop_shared_memory()))
+    {
+        SHARED_READ_BEGIN( &desktop->seq )
+        {
+            msg->pt.x = desktop->cursor.x;
+            msg->pt.y = desktop->cursor.y;
+        }
+        SHARED_READ_END( &desktop->seq );
+    }
+    return TRUE;
+}
+
+static BOOL match_local_posted_message( const MSG *msg, HWND hwnd, UINT first, UINT last )
+{
+    if (msg->message < first || msg->message > last) return FALSE;
+    if (!hwnd) return TRUE;
+    if (hwnd == (HWND)-1 || hwnd == (HWND)1) return !msg->hwnd;
+    return msg->hwnd == hwnd || is_child( hwnd, msg->hwnd );
+}
+
+/* return the index of the first local message matching the filter, or -1 */
+static int find_local_posted_message( HWND hwnd, UINT first, UINT last )
+{
+    struct local_post_queue *queue = get_user_thread_info()->local_posted;
+    unsigned int i;
+
+    if (!queue) return -1;
+    for (i = 0; i < queue->count; i++)
+        if (match_local_posted_message( get_local_posted_message( queue, i ), hwnd, first, last ))
+            return i;
+    return -1;
+}
+
+static void remove_local_posted_message( struct local_post_queue *queue, unsigned int index )
+{
+    if (index < queue->seen) queue->seen--;
+    if (!index)
+        queue->head = (queue->head + 1) % LOCAL_POST_QUEUE_SIZE;
+    else
+    {
+        for (; index + 1 < queue->count; index++)
+            *get_local_posted_message( queue, index ) = *get_local_posted_message( queue, index + 1 );
+    }
+    queue->count--;
+}
+
+/***********************************************************************
+ *           drop_local_posted_messages
+ *
+ * Remove the local messages posted to a window that is being destroyed.
+ */
+void drop_local_posted_messages( HWND hwnd )
+{
+    struct local_post_queue *queue = get_user_thread_info()->local_posted;
+    unsigned int i = 0;
+
+    if (!queue) return;
+    while (i < queue->count)
+    {
+        if (get_local_posted_message( queue, i )->hwnd == hwnd) remove_local_posted_message( queue, i );
+        else i++;
+    }
+}
+
+/***********************************************************************
+ *           flush_local_posted_messages
+ *
+ * Move the local posted messages to the server queue, ahead of the
+ * messages it already contains.
+ */
+void flush_local_posted_messages(void)
+{
+    struct local_post_queue *queue = get_user_thread_info()->local_posted;
+
+    if (!queue) return;
+    while (queue->count)
+    {
+        MSG *msg = get_local_posted_message( queue, queue->count - 1 );
+
+        SERVER_START_REQ( send_message )
+        {
+            req->id      = GetCurrentThreadId();
+            req->type    = MSG_POSTED;
+            req->flags   = SEND_MSG_POST_FIRST;
+            if (queue->count <= queue->seen) req->flags |= SEND_MSG_POST_SEEN;
+            req->win     = wine_server_user_handle( msg->hwnd );
+            req->msg     = msg->message;
+            req->wparam  = msg->wParam;
+            req->lparam  = msg->lParam;
+            req->timeout = TIMEOUT_INFINITE;
+            wine_server_call( req );
+        }
+        SERVER_END_REQ;
+        queue->count--;
+    }
+    queue->seen = 0;
+}
+
 /***********************************************************************
  *           peek_message
  *
@@ -1913,7 +2068,24 @@ static int peek_message( MSG *msg, HWND hwnd, UINT first, UINT last, UINT flags,
         const message_data_t *msg_data = buffer;
         BOOL needs_unpack = FALSE;
         UINT wake_mask = changed_mask & (QS_SENDMESSAGE | QS_SMRESULT);
+        UINT server_flags = flags;
         DWORD clear_bits = 0, filter = flags >> 16 ? flags >> 16 : QS_ALLINPUT;
+        int local = -1;
+
+        /* local messages come before anything posted through the server,
+         * only sent messages need to be processed before them */
+        if ((filter & QS_POSTMESSAGE) && thread_info->local_posted)
+        {
+            /* like the server changed bits, peeking marks all the posted messages as seen */
+            thread_info->local_posted->seen = thread_info->local_posted->count;
+            local = find_local_posted_message( hwnd, first, last );
+        }
+        if (local != -1)
+        {
+            server_flags = LOWORD(flags) | PM_QS_SENDMESSAGE;
+            filter = QS_SENDMESSAGE;
+        }
+
         if (filter & QS_POSTMESSAGE)
         {
             clear_bits |= QS_POSTMESSAGE | QS_HOTKEY | QS_TIMER;
@@ -1924,7 +2096,7 @@ static int peek_message( MSG *msg, HWND hwnd, UINT first, UINT last, UINT flags,
 
         thread_info->client_info.msg_source = prev_source;
 
-        if (!shared || waited || NtGetTickCount() - thread_info->last_getmsg_time >= 3000) skip = FALSE;
+        if (!shared || (waited && local == -1) || NtGetTickCount() - thread_info->last_getmsg_time >= 3000) skip = FALSE;
         else SHARED_READ_BEGIN( &shared->seq )
         {
             /* not created yet */
@@ -1946,7 +2118,7 @@ static int peek_message( MSG *msg, HWND hwnd, UINT first, UINT last, UINT flags,
         if (skip) res = STATUS_PENDING;
         else SERVER_START_REQ( get_message )
         {
-            req->flags     = flags;
+            req->flags     = server_flags;
             req->get_win   = wine_server_user_handle( hwnd );
             req->get_first = first;
             req->get_last  = last;
@@ -1975,6 +2147,16 @@ static int peek_message( MSG *msg, HWND hwnd, UINT first, UINT last, UINT flags,
         /* force refreshing hooks */
         thread_info->active_hooks = 0;
 
+        if (res == STATUS_PENDING && local != -1)
+        {
+            struct local_post_queue *queue = thread_info->local_posted;
+
+            info.type = MSG_POSTED;
+            info.msg  = *get_local_posted_message( queue, local );
+            if (flags & PM_REMOVE) remove_local_posted_message( queue, local );
+            res = 0;
+        }
+
         if (res)
         {
             if (res == STATUS_PENDING)
@@ -2316,6 +2498,7 @@ static DWORD wait_objects( DWORD count, const HANDLE *handles, DWORD timeout,
 
     assert( count );  /* we must have at least the server queue */
 
+    flush_local_posted_messages();
     flush_window_surfaces( TRUE );
 
     if (thread_info->wake_mask != wake_mask || thread_info->changed_mask != changed_mask)
@@ -2536,6 +2719,8 @@ static BOOL put_message_in_queue( const struct send_message_info *info, size_t *
         timeout = (timeout_t)max( 0, (int)info->timeout ) * -10000;
     }
 
+    if (info->type == MSG_POSTED && post_local_message( info )) return TRUE;
+
     memset( &data, 0, sizeof(data) );
     if (info->type == MSG_OTHER_PROCESS || info->type == MSG_NOTIFY)
     {
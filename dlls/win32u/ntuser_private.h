@@ -146,6 +146,7 @@ struct user_thread_info
     struct queue_shared_memory   *queue_shared_memory;    /* Ptr to server's thread queue shared memory */
     struct input_shared_memory   *input_shared_memory;    /* Ptr to server's thread input shared memory */
     struct input_shared_memory   *foreground_shared_memory; /* Ptr to server's thread input shared memory */
+    struct local_post_queue      *local_posted;           /* Messages posted to self, not yet in the server queue */
 };
 
 C_ASSERT( sizeof(struct user_thread_info) <= sizeof(((TEB *)0)->Win32ClientInfo) );
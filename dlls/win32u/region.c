@@ -981,6 +981,32 @@ BOOL WINAPI NtGdiPtInRegion( HRGN hrgn, INT x, INT y )
 }
 
 
+/* find the end of the band starting at the given rectangle */
+static int find_band_end( const WINEREGION *obj, int start )
+{
+    int top = obj->rects[start].top, end = obj->numRects;
+
+    while (start < end)
+    {
+        int i = (start + end) / 2;
+        if (obj->rects[i].top <= top) start = i + 1;
+        else end = i;
+    }
+    return start;
+}
+
+/* find the first rectangle of a band that ends after x */
+static int find_rect_in_band( const WINEREGION *obj, int start, int end, int x )
+{
+    while (start < end)
+    {
+        int i = (start + end) / 2;
+        if (obj->rects[i].right <= x) start = i + 1;
+        else end = i;
+    }
+    return start;
+}
+
 /***********************************************************************
  *           NtGdiRectInRegion    (win32u.@)
  *
@@ -999,7 +1025,7 @@ BOOL WINAPI NtGdiRectInRegion( HRGN hrgn, const RECT *rect )
     WINEREGION *obj;
     BOOL ret = FALSE;
     RECT rc;
-    int i;
+    int i, end;
 
     /* swap the coordinates to make right >= left and bottom >= top */
     /* (region building rectangles are normalized the same way) */
@@ -1010,21 +1036,17 @@ BOOL WINAPI NtGdiRectInRegion( HRGN hrgn, const RECT *rect )
     {
 	if ((obj->numRects > 0) && overlapping(&obj->extents, &rc))
 	{
-	    for (i = region_find_pt( obj, rc.left, rc.top, &ret ); !ret && i < obj->numRects; i++ )
+	    /* binary search the first rectangle right of rc.left in each band overlapping rc */
+	    for (i = region_find_pt( obj, rc.left, rc.top, &ret ); !ret && i < obj->numRects; i = end)
 	    {
-	        if (obj->rects[i].bottom <= rc.top)
-		    continue;             /* not far enough down yet */
-
 		if (obj->rects[i].top >= rc.bottom)
 		    break;                /* too far down */
 
+		end = find_band_end( obj, i );
 		if (obj->rects[i].right <= rc.left)
-		    continue;              /* not far enough over yet */
-
-		if (obj->rects[i].left >= rc.right)
-		    continue;
+		    i = find_rect_in_band( obj, i, end, rc.left );
 
-		ret = TRUE;
+		ret = i < end && obj->rects[i].left < rc.right;
 	    }
 	}
 	GDI_ReleaseObj(hrgn);
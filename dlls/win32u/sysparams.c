@@ -5715,6 +5715,8 @@ static void thread_detach(void)
 
     destroy_thread_windows();
     cleanup_imm_thread();
+    free( thread_info->local_posted );
+    thread_info->local_posted = NULL;
     NtClose( thread_info->server_queue );
 
     if (thread_info->desktop_shared_memory)
@@ -4694,6 +4694,7 @@ static void free_window_handle( HWND hwnd )
 
     if ((win = get_user_handle_ptr( hwnd, NTUSER_OBJ_WINDOW )) && win != OBJ_OTHER_PROCESS)
     {
+        drop_local_posted_messages( hwnd );
         SERVER_START_REQ( destroy_window )
         {
             req->handle = wine_server_user_handle( hwnd );
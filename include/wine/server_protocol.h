@@ -2837,6 +2837,8 @@ enum message_type
     MSG_HOOK_LL
 };
 #define SEND_MSG_ABORT_IF_HUNG  0x01
+#define SEND_MSG_POST_FIRST     0x02
+#define SEND_MSG_POST_SEEN      0x04
 
 
 
@@ -6682,7 +6684,7 @@ union generic_reply
 
 /* ### protocol_version begin ### */
 
-#define SERVER_PROTOCOL_VERSION 759
+#define SERVER_PROTOCOL_VERSION 761
 
 /* ### protocol_version end ### */
 
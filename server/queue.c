@@ -36,6 +36,7 @@
 #include "winternl.h"
 #include "ntuser.h"
 
+#include "wine/rbtree.h"
 #include "handle.h"
 #include "file.h"
 #include "thread.h"
@@ -91,7 +92,11 @@ struct message
 
 struct timer
 {
-    struct list     entry;     /* entry in timer list */
+    struct list     entry;     /* entry in expired timers list */
+    struct wine_rb_entry pending_entry; /* entry in pending timers tree */
+    struct list     hash_entry; /* entry in timer hash table */
+    int             expired;   /* in the expired list? */
+    unsigned int    seq;       /* sequence number for ordering timers with the same expiration */
     abstime_t       when;      /* next expiration */
     unsigned int    rate;      /* timer rate in ms */
     user_handle_t   win;       /* window handle */
@@ -100,6 +105,8 @@ struct timer
     lparam_t        lparam;    /* lparam for message */
 };
 
+#define TIMER_HASH_SIZE 64
+
 struct thread_input
 {
     struct object          obj;           /* object header */
@@ -130,8 +137,10 @@ struct msg_queue
     struct list            send_result;     /* stack of sent messages waiting for result */
     struct list            callback_result; /* list of callback messages waiting for result */
     struct message_result *recv_result;     /* stack of received messages waiting for result */
-    struct list            pending_timers;  /* list of pending timers */
+    struct wine_rb_tree    pending_timers;  /* tree of pending timers, in expiration order */
     struct list            expired_timers;  /* list of expired timers */
+    struct list           *timer_hash;      /* hash table of timers by window, msg and id */
+    unsigned int           timer_seq;       /* sequence number of the last linked timer */
     lparam_t               next_timer_id;   /* id for the next timer with a 0 window */
     struct timeout_user   *timeout;         /* timeout for next timer to expire */
     struct thread_input   *input;           /* thread input descriptor */
@@ -167,6 +176,7 @@ static void msg_queue_poll_event( struct fd *fd, int event );
 static void thread_input_dump( struct object *obj, int verbose );
 static void thread_input_destroy( struct object *obj );
 static void timer_callback( void *private );
+static int compare_timers( const void *key, const struct wine_rb_entry *entry );
 
 static const struct object_ops msg_queue_ops =
 {
@@ -376,8 +386,10 @@ static struct msg_queue *create_msg_queue( struct thread *thread, struct thread_
         queue->shared          = thread->queue_shared;
         list_init( &queue->send_result );
         list_init( &queue->callback_result );
-        list_init( &queue->pending_timers );
+        wine_rb_init( &queue->pending_timers, compare_timers );
         list_init( &queue->expired_timers );
+        queue->timer_hash      = NULL;
+        queue->timer_seq       = 0;
         for (i = 0; i < NB_MSG_KINDS; i++) list_init( &queue->msg_list[i] );
 
         if (do_fsync())
@@ -672,8 +684,8 @@ static inline int is_signaled( struct msg_queue *queue )
     return ((queue->wake_bits & queue->wake_mask) || (queue->changed_bits & queue->changed_mask));
 }
 
-/* set some queue bits */
-static inline void set_queue_bits( struct msg_queue *queue, unsigned int bits )
+/* set some queue bits, only reporting the changed ones as new */
+static inline void set_queue_wake_bits( struct msg_queue *queue, unsigned int bits, unsigned int changed )
 {
     if (bits & (QS_KEY | QS_MOUSEBUTTON))
     {
@@ -681,7 +693,7 @@ static inline void set_queue_bits( struct msg_queue *queue, unsigned int bits )
         queue->keystate_lock = 1;
     }
     queue->wake_bits |= bits;
-    queue->changed_bits |= bits;
+    queue->changed_bits |= changed;
 
     SHARED_WRITE_BEGIN( &queue->shared->seq );
     queue->shared->wake_bits = queue->wake_bits;
@@ -691,6 +703,12 @@ static inline void set_queue_bits( struct msg_queue *queue, unsigned int bits )
     if (is_signaled( queue )) wake_up( &queue->obj, 0 );
 }
 
+/* set some queue bits */
+static inline void set_queue_bits( struct msg_queue *queue, unsigned int bits )
+{
+    set_queue_wake_bits( queue, bits, bits );
+}
+
 /* clear some queue bits */
 static inline void clear_queue_bits( struct msg_queue *queue, unsigned int bits )
 {
@@ -1339,17 +1357,18 @@ static void cleanup_msg_queue( struct msg_queue *queue )
         }
     }
 
-    while ((ptr = list_head( &queue->pending_timers )))
+    if (queue->timer_hash)
     {
-        struct timer *timer = LIST_ENTRY( ptr, struct timer, entry );
-        list_remove( &timer->entry );
-        free( timer );
-    }
-    while ((ptr = list_head( &queue->expired_timers )))
-    {
-        struct timer *timer = LIST_ENTRY( ptr, struct timer, entry );
-        list_remove( &timer->entry );
-        free( timer );
+        for (i = 0; i < TIMER_HASH_SIZE; i++)
+        {
+            while ((ptr = list_head( &queue->timer_hash[i] )))
+            {
+                struct timer *timer = LIST_ENTRY( ptr, struct timer, hash_entry );
+                list_remove( &timer->hash_entry );
+                free( timer );
+            }
+        }
+        free( queue->timer_hash );
     }
     if (queue->timeout) remove_timeout_user( queue->timeout );
     SHARED_WRITE_BEGIN( &queue->input->shared->seq );
@@ -1531,19 +1550,36 @@ void detach_thread_input( struct thread *thread_from )
 }
 
 
+/* pending timers are sorted by expiration time (stored as a negative abstime),
+ * timers expiring at the same time in reverse order of linking */
+static int compare_timers( const void *key, const struct wine_rb_entry *entry )
+{
+    const struct timer *timer = key;
+    const struct timer *t = WINE_RB_ENTRY_VALUE( entry, const struct timer, pending_entry );
+
+    if (timer->when != t->when) return timer->when > t->when ? -1 : 1;
+    if (timer->seq != t->seq) return timer->seq > t->seq ? -1 : 1;
+    return 0;
+}
+
+static inline unsigned int get_timer_hash( user_handle_t win, unsigned int msg, lparam_t id )
+{
+    return (win ^ msg ^ (unsigned int)id ^ (unsigned int)(id >> 32)) % TIMER_HASH_SIZE;
+}
+
 /* set the next timer to expire */
 static void set_next_timer( struct msg_queue *queue )
 {
-    struct list *ptr;
+    struct wine_rb_entry *ptr;
 
     if (queue->timeout)
     {
         remove_timeout_user( queue->timeout );
         queue->timeout = NULL;
     }
-    if ((ptr = list_head( &queue->pending_timers )))
+    if ((ptr = rb_head( queue->pending_timers.root )))
     {
-        struct timer *timer = LIST_ENTRY( ptr, struct timer, entry );
+        struct timer *timer = WINE_RB_ENTRY_VALUE( ptr, struct timer, pending_entry );
         queue->timeout = add_timeout_user( abstime_to_timeout(timer->when), timer_callback, queue );
     }
     /* set/clear QS_TIMER bit */
@@ -1557,20 +1593,12 @@ static void set_next_timer( struct msg_queue *queue )
 static struct timer *find_timer( struct msg_queue *queue, user_handle_t win,
                                  unsigned int msg, lparam_t id )
 {
-    struct list *ptr;
+    struct timer *timer;
 
-    /* we need to search both lists */
+    if (!queue->timer_hash) return NULL;
 
-    LIST_FOR_EACH( ptr, &queue->pending_timers )
-    {
-        struct timer *timer = LIST_ENTRY( ptr, struct timer, entry );
+    LIST_FOR_EACH_ENTRY( timer, &queue->timer_hash[get_timer_hash( win, msg, id )], struct timer, hash_entry )
         if (timer->win == win && timer->msg == msg && timer->id == id) return timer;
-    }
-    LIST_FOR_EACH( ptr, &queue->expired_timers )
-    {
-        struct timer *timer = LIST_ENTRY( ptr, struct timer, entry );
-        if (timer->win == win && timer->msg == msg && timer->id == id) return timer;
-    }
     return NULL;
 }
 
@@ -1578,33 +1606,37 @@ static struct timer *find_timer( struct msg_queue *queue, user_handle_t win,
 static void timer_callback( void *private )
 {
     struct msg_queue *queue = private;
-    struct list *ptr;
+    struct timer *timer;
 
     queue->timeout = NULL;
     /* move on to the next timer */
-    ptr = list_head( &queue->pending_timers );
-    list_remove( ptr );
-    list_add_tail( &queue->expired_timers, ptr );
+    timer = WINE_RB_ENTRY_VALUE( rb_head( queue->pending_timers.root ), struct timer, pending_entry );
+    wine_rb_remove( &queue->pending_timers, &timer->pending_entry );
+    list_add_tail( &queue->expired_timers, &timer->entry );
+    timer->expired = 1;
     set_next_timer( queue );
 }
 
-/* link a timer at its rightful place in the queue list */
+/* link a timer at its rightful place in the queue pending timers */
 static void link_timer( struct msg_queue *queue, struct timer *timer )
 {
-    struct list *ptr;
+    timer->seq = ++queue->timer_seq;
+    timer->expired = 0;
+    wine_rb_put( &queue->pending_timers, timer, &timer->pending_entry );
+}
 
-    for (ptr = queue->pending_timers.next; ptr != &queue->pending_timers; ptr = ptr->next)
-    {
-        struct timer *t = LIST_ENTRY( ptr, struct timer, entry );
-        if (t->when <= timer->when) break;
-    }
-    list_add_before( ptr, &timer->entry );
+/* remove a timer from the pending tree or the expired list */
+static void unlink_timer( struct msg_queue *queue, struct timer *timer )
+{
+    if (timer->expired) list_remove( &timer->entry );
+    else wine_rb_remove( &queue->pending_timers, &timer->pending_entry );
 }
 
 /* remove a timer from the queue timer list and free it */
 static void free_timer( struct msg_queue *queue, struct timer *timer )
 {
-    list_remove( &timer->entry );
+    unlink_timer( queue, timer );
+    list_remove( &timer->hash_entry );
     free( timer );
     set_next_timer( queue );
 }
@@ -1612,7 +1644,7 @@ static void free_timer( struct msg_queue *queue, struct timer *timer )
 /* restart an expired timer */
 static void restart_timer( struct msg_queue *queue, struct timer *timer )
 {
-    list_remove( &timer->entry );
+    unlink_timer( queue, timer );
     while (-timer->when <= monotonic_time) timer->when -= (timeout_t)timer->rate * 10000;
     link_timer( queue, timer );
     set_next_timer( queue );
@@ -1639,16 +1671,29 @@ static struct timer *find_expired_timer( struct msg_queue *queue, user_handle_t
 }
 
 /* add a timer */
-static struct timer *set_timer( struct msg_queue *queue, unsigned int rate )
+static struct timer *set_timer( struct msg_queue *queue, unsigned int rate, user_handle_t win,
+                                unsigned int msg, lparam_t id )
 {
-    struct timer *timer = mem_alloc( sizeof(*timer) );
-    if (timer)
+    struct timer *timer;
+    unsigned int i;
+
+    if (!queue->timer_hash)
+    {
+        if (!(queue->timer_hash = mem_alloc( TIMER_HASH_SIZE * sizeof(*queue->timer_hash) ))) return NULL;
+        for (i = 0; i < TIMER_HASH_SIZE; i++) list_init( &queue->timer_hash[i] );
+    }
+
+    if ((timer = mem_alloc( sizeof(*timer) )))
     {
         timer->rate = max( rate, 1 );
         timer->when = -monotonic_time - (timeout_t)timer->rate * 10000;
+        timer->win  = win;
+        timer->msg  = msg;
+        timer->id   = id;
+        list_add_head( &queue->timer_hash[get_timer_hash( win, msg, id )], &timer->hash_entry );
         link_timer( queue, timer );
         /* check if we replaced the next timer */
-        if (list_head( &queue->pending_timers ) == &timer->entry) set_next_timer( queue );
+        if (rb_head( queue->pending_timers.root ) == &timer->pending_entry) set_next_timer( queue );
     }
     return timer;
 }
@@ -2647,28 +2692,21 @@ void inc_queue_paint_count( struct thread *thread, int incr )
 void queue_cleanup_window( struct thread *thread, user_handle_t win )
 {
     struct msg_queue *queue = thread->queue;
-    struct list *ptr;
     int i;
 
     if (!queue) return;
 
     /* remove timers */
 
-    ptr = list_head( &queue->pending_timers );
-    while (ptr)
+    if (queue->timer_hash)
     {
-        struct list *next = list_next( &queue->pending_timers, ptr );
-        struct timer *timer = LIST_ENTRY( ptr, struct timer, entry );
-        if (timer->win == win) free_timer( queue, timer );
-        ptr = next;
-    }
-    ptr = list_head( &queue->expired_timers );
-    while (ptr)
-    {
-        struct list *next = list_next( &queue->expired_timers, ptr );
-        struct timer *timer = LIST_ENTRY( ptr, struct timer, entry );
-        if (timer->win == win) free_timer( queue, timer );
-        ptr = next;
+        for (i = 0; i < TIMER_HASH_SIZE; i++)
+        {
+            struct timer *timer, *next;
+
+            LIST_FOR_EACH_ENTRY_SAFE( timer, next, &queue->timer_hash[i], struct timer, hash_entry )
+                if (timer->win == win) free_timer( queue, timer );
+        }
     }
 
     /* remove messages */
@@ -3000,8 +3038,13 @@ DECL_HANDLER(send_message)
             set_queue_bits( recv_queue, QS_SENDMESSAGE );
             break;
         case MSG_POSTED:
-            list_add_tail( &recv_queue->msg_list[POST_MESSAGE], &msg->entry );
-            set_queue_bits( recv_queue, QS_POSTMESSAGE|QS_ALLPOSTMESSAGE );
+            if (req->flags & SEND_MSG_POST_FIRST)
+                list_add_head( &recv_queue->msg_list[POST_MESSAGE], &msg->entry );
+            else
+                list_add_tail( &recv_queue->msg_list[POST_MESSAGE], &msg->entry );
+            /* a message already seen by the receiving thread is not reported as new */
+            set_queue_wake_bits( recv_queue, QS_POSTMESSAGE|QS_ALLPOSTMESSAGE,
+                                 (req->flags & SEND_MSG_POST_SEEN) ? 0 : QS_POSTMESSAGE|QS_ALLPOSTMESSAGE );
             if (msg->msg == WM_HOTKEY)
             {
                 set_queue_bits( recv_queue, QS_HOTKEY );
@@ -3308,11 +3351,8 @@ DECL_HANDLER(set_win_timer)
         }
     }
 
-    if ((timer = set_timer( queue, req->rate )))
+    if ((timer = set_timer( queue, req->rate, win, req->msg, id )))
     {
-        timer->win    = win;
-        timer->msg    = req->msg;
-        timer->id     = id;
         timer->lparam = req->lparam;
         reply->id     = id;
     }
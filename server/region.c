@@ -105,6 +105,11 @@ typedef int (*non_overlap_func_t)( struct region *reg, const rectangle_t *r,
 
 static const rectangle_t empty_rect;  /* all-zero rectangle for empty regions */
 
+/* scratch buffer for region_op, larger ones are not kept around */
+#define MAX_OP_BUFFER_SIZE 4096
+static rectangle_t *op_buffer;
+static int op_buffer_size;
+
 /* add a rectangle to a region */
 static inline rectangle_t *add_rect( struct region *reg )
 {
@@ -220,13 +225,24 @@ static int region_op( struct region *newReg, const struct region *reg1, const st
     const rectangle_t *r2End = r2 + reg2->num_rects;
 
     rectangle_t *new_rects, *old_rects = newReg->rects;
-    int new_size, ret = 0;
+    int new_size, old_size = newReg->size, ret = 0;
 
+    /* the result is built in a scratch buffer kept across calls and copied back into
+     * the destination rectangles, which are only reallocated when they don't fit */
     new_size = max( reg1->num_rects, reg2->num_rects ) * 2;
-    if (!(new_rects = mem_alloc( new_size * sizeof(*newReg->rects) ))) return 0;
+    if (op_buffer_size < new_size)
+    {
+        if (!(new_rects = realloc( op_buffer, new_size * sizeof(*op_buffer) )))
+        {
+            set_error( STATUS_NO_MEMORY );
+            return 0;
+        }
+        op_buffer = new_rects;
+        op_buffer_size = new_size;
+    }
 
-    newReg->size = new_size;
-    newReg->rects = new_rects;
+    newReg->size = op_buffer_size;
+    newReg->rects = op_buffer;
     newReg->num_rects = 0;
 
     if (reg1->extents.top < reg2->extents.top)
@@ -320,19 +336,40 @@ static int region_op( struct region *newReg, const struct region *reg1, const st
     }
 
     if (newReg->num_rects != curBand) coalesce_region(newReg, prevBand, curBand);
+    ret = 1;
+
+done:
+    /* add_rect() may have grown the scratch buffer */
+    op_buffer = newReg->rects;
+    op_buffer_size = newReg->size;
+    newReg->rects = old_rects;
+    newReg->size = old_size;
 
-    if ((newReg->num_rects < (newReg->size / 2)) && (newReg->size > 2))
+    if (!ret) newReg->num_rects = 0;
+    else if (newReg->num_rects > old_size ||
+             ((newReg->num_rects < old_size / 2) && (old_size > RGN_DEFAULT_RECTS)))
     {
         new_size = max( newReg->num_rects, RGN_DEFAULT_RECTS );
-        if ((new_rects = realloc( newReg->rects, sizeof(*newReg->rects) * new_size )))
+        if ((new_rects = mem_alloc( new_size * sizeof(*new_rects) )))
         {
+            free( old_rects );
             newReg->rects = new_rects;
             newReg->size = new_size;
         }
+        else
+        {
+            newReg->num_rects = 0;
+            ret = 0;
+        }
+    }
+    if (ret) memcpy( newReg->rects, op_buffer, newReg->num_rects * sizeof(*op_buffer) );
+
+    if (op_buffer_size > MAX_OP_BUFFER_SIZE)
+    {
+        free( op_buffer );
+        op_buffer = NULL;
+        op_buffer_size = 0;
     }
-    ret = 1;
-done:
-    free( old_rects );
     return ret;
 }
 
@@ -855,35 +892,75 @@ struct region *xor_region( struct region *dst, const struct region *src1,
     return dst;
 }
 
-/* check if the given point is inside the region */
-int point_in_region( struct region *region, int x, int y )
+/* find the first rectangle at or after start that ends below y */
+static int find_band( const struct region *region, int start, int y )
 {
-    const rectangle_t *ptr, *end;
+    int end = region->num_rects;
 
-    for (ptr = region->rects, end = region->rects + region->num_rects; ptr < end; ptr++)
+    while (start < end)
     {
-        if (ptr->top > y) return 0;
-        if (ptr->bottom <= y) continue;
-        /* now we are in the correct band */
-        if (ptr->left > x) return 0;
-        if (ptr->right <= x) continue;
-        return 1;
+        int i = (start + end) / 2;
+        if (region->rects[i].bottom <= y) start = i + 1;
+        else end = i;
     }
-    return 0;
+    return start;
+}
+
+/* find the end of the band starting at the given rectangle */
+static int find_band_end( const struct region *region, int start )
+{
+    int top = region->rects[start].top, end = region->num_rects;
+
+    while (start < end)
+    {
+        int i = (start + end) / 2;
+        if (region->rects[i].top <= top) start = i + 1;
+        else end = i;
+    }
+    return start;
+}
+
+/* find the first rectangle of a band that ends after x */
+static int find_rect_in_band( const struct region *region, int start, int end, int x )
+{
+    while (start < end)
+    {
+        int i = (start + end) / 2;
+        if (region->rects[i].right <= x) start = i + 1;
+        else end = i;
+    }
+    return start;
+}
+
+/* check if the given point is inside the region */
+int point_in_region( struct region *region, int x, int y )
+{
+    int i, end;
+
+    if (!region->num_rects) return 0;
+    if (x < region->extents.left || x >= region->extents.right ||
+        y < region->extents.top || y >= region->extents.bottom) return 0;
+
+    i = find_band( region, 0, y );
+    if (i == region->num_rects || region->rects[i].top > y) return 0;
+    end = find_band_end( region, i );
+    i = find_rect_in_band( region, i, end, x );
+    return i < end && region->rects[i].left <= x;
 }
 
 /* check if the given rectangle is (at least partially) inside the region */
 int rect_in_region( struct region *region, const rectangle_t *rect )
 {
-    const rectangle_t *ptr, *end;
+    int i, end;
+
+    if (!region->num_rects || !EXTENTCHECK( &region->extents, rect )) return 0;
 
-    for (ptr = region->rects, end = region->rects + region->num_rects; ptr < end; ptr++)
+    for (i = find_band( region, 0, rect->top ); i < region->num_rects; i = end)
     {
-        if (ptr->top >= rect->bottom) return 0;
-        if (ptr->bottom <= rect->top) continue;
-        if (ptr->left >= rect->right) continue;
-        if (ptr->right <= rect->left) continue;
-        return 1;
+        if (region->rects[i].top >= rect->bottom) return 0;
+        end = find_band_end( region, i );
+        i = find_rect_in_band( region, i, end, rect->left );
+        if (i < end && region->rects[i].left < rect->right) return 1;
     }
     return 0;
 }
@@ -44,6 +44,34 @@ struct property
     lparam_t       data;     /* property data (user-defined storage) */
 };
 
+/* grid of the children rectangles, used to speed up hit-testing */
+struct child_index
+{
+    rectangle_t     bounds;       /* bounding rectangle of the indexed children */
+    unsigned int    cols;         /* number of grid columns */
+    unsigned int    rows;         /* number of grid rows */
+    unsigned int    cell_width;   /* width of a grid cell */
+    unsigned int    cell_height;  /* height of a grid cell */
+    unsigned int   *offsets;      /* start of each cell in the windows array (cols * rows + 1 entries) */
+    struct window **windows;      /* children overlapping each cell, in Z-order */
+    unsigned int    moved_count;  /* number of children moved since the grid was built */
+    struct window  *moved[16];    /* children moved since the grid was built, in Z-order */
+};
+
+#define CHILD_INDEX_MIN_COUNT 64  /* don't bother indexing fewer children */
+#define CHILD_INDEX_MAX_CELLS 64  /* maximum number of grid columns and rows */
+
+/* a cached visible region */
+struct visible_cache
+{
+    struct region   *region;      /* visible region in window coordinates, or NULL if unused */
+    unsigned int     flags;       /* DCX_* flags it was computed for */
+    unsigned int     ops;         /* number of region operations it took to compute */
+    unsigned __int64 serial;      /* visible_serial at the time it was computed */
+};
+
+#define VISIBLE_CACHE_SIZE 2
+
 enum property_type
 {
     PROP_TYPE_FREE,   /* free entry */
@@ -80,6 +108,13 @@ struct window
     unsigned int     is_linked : 1;   /* is it linked into the parent z-order list? */
     unsigned int     is_layered : 1;  /* has layered info been set? */
     unsigned int     is_orphan : 1;   /* is window orphaned */
+    unsigned int     child_index_valid : 1; /* is child_index up to date with the children list? */
+    unsigned int     child_index_moved : 1; /* has it moved since the parent child_index was built? */
+    unsigned int     child_z;         /* position in the parent Z-order when child_index was built */
+    struct child_index *child_index;  /* spatial index of the children, if any */
+    unsigned __int64 vis_serial;      /* last change to the visible region of the window itself */
+    unsigned __int64 tree_serial;     /* last change to the visible regions of the window and its descendants */
+    struct visible_cache vis_cache[VISIBLE_CACHE_SIZE]; /* cached visible regions, most recent first */
     unsigned int     color_key;       /* color key for a layered window */
     unsigned int     alpha;           /* alpha value for a layered window */
     unsigned int     layered_flags;   /* flags for a layered window */
@@ -146,6 +181,13 @@ struct user_handle_array
 
 static const rectangle_t empty_rect;
 
+/* visible region cache state and statistics */
+static unsigned __int64 visible_serial;
+static unsigned int visible_cache_hits;
+static unsigned int visible_cache_misses;
+static unsigned int visible_region_ops;
+static unsigned int visible_region_ops_saved;
+
 /* global window pointers */
 static struct window *shell_window;
 static struct window *shell_listview;
@@ -163,19 +205,44 @@ static void window_dump( struct object *obj, int verbose )
     struct window *win = (struct window *)obj;
     assert( obj->ops == &window_ops );
     fprintf( stderr, "window %p handle %x\n", win, win->handle );
+    if (verbose && !win->parent)
+        fprintf( stderr, "  visible region cache: %u hits, %u misses, %u region operations saved\n",
+                 visible_cache_hits, visible_cache_misses, visible_region_ops_saved );
+}
+
+/* mark the spatial index of the children of a window as outdated */
+static void invalidate_child_index( struct window *win )
+{
+    unsigned int i;
+
+    if (win->child_index)
+    {
+        for (i = 0; i < win->child_index->moved_count; i++)
+            win->child_index->moved[i]->child_index_moved = 0;
+        free( win->child_index->offsets );
+        free( win->child_index->windows );
+        free( win->child_index );
+        win->child_index = NULL;
+    }
+    win->child_index_valid = 0;
 }
 
 static void window_destroy( struct object *obj )
 {
     struct window *win = (struct window *)obj;
+    unsigned int i;
 
     assert( !win->handle );
 
     if (win->parent)
     {
         list_remove( &win->entry );
+        invalidate_child_index( win->parent );
         release_object( win->parent );
     }
+    invalidate_child_index( win );
+    for (i = 0; i < VISIBLE_CACHE_SIZE; i++)
+        if (win->vis_cache[i].region) free_region( win->vis_cache[i].region );
 
     if (win->win_region) free_region( win->win_region );
     if (win->update_region) free_region( win->update_region );
@@ -255,6 +322,37 @@ static unsigned int get_monitor_dpi( struct window *win )
     return win->dpi ? win->dpi : USER_DEFAULT_SCREEN_DPI;
 }
 
+/* invalidate the cached visible regions that may depend on a window, old_rect is its previous visible rect */
+static void invalidate_visible_regions( struct window *win, const rectangle_t *old_rect )
+{
+    struct window *ptr;
+    rectangle_t rect, tmp;
+
+    win->tree_serial = ++visible_serial;
+    if (!win->parent) return;
+    win->parent->vis_serial = visible_serial;  /* for DCX_CLIPCHILDREN */
+
+    /* top-level siblings don't clip each other */
+    if (is_desktop_window( win->parent )) return;
+
+    LIST_FOR_EACH_ENTRY( ptr, &win->parent->children, struct window, entry )
+    {
+        if (ptr == win) continue;
+        /* the visible regions of a sibling and its descendants are clipped to its window rect */
+        rect = ptr->window_rect;
+        if (!is_rect_empty( &ptr->visible_rect ))
+        {
+            rect.left   = min( rect.left, ptr->visible_rect.left );
+            rect.top    = min( rect.top, ptr->visible_rect.top );
+            rect.right  = max( rect.right, ptr->visible_rect.right );
+            rect.bottom = max( rect.bottom, ptr->visible_rect.bottom );
+        }
+        if (intersect_rect( &tmp, &rect, &win->visible_rect ) ||
+            (old_rect && intersect_rect( &tmp, &rect, old_rect )))
+            ptr->tree_serial = visible_serial;
+    }
+}
+
 /* link a window at the right place in the siblings list */
 static int link_window( struct window *win, struct window *previous )
 {
@@ -311,7 +409,10 @@ static int link_window( struct window *win, struct window *previous )
     }
 
     win->is_linked = 1;
-    return old_prev != win->entry.prev;
+    invalidate_visible_regions( win, NULL );
+    if (old_prev == win->entry.prev) return 0;
+    invalidate_child_index( win->parent );
+    return 1;
 }
 
 /* change the parent of a window (or unlink the window if the new parent is NULL) */
@@ -331,7 +432,15 @@ static int set_parent_window( struct window *win, struct window *parent )
 
     if (parent)
     {
-        if (win->parent) release_object( win->parent );
+        if (win->parent)
+        {
+            if (win->is_linked)
+            {
+                invalidate_child_index( win->parent );
+                invalidate_visible_regions( win, NULL );
+            }
+            release_object( win->parent );
+        }
         win->parent = (struct window *)grab_object( parent );
         link_window( win, WINPTR_TOP );
 
@@ -339,6 +448,7 @@ static int set_parent_window( struct window *win, struct window *parent )
         {
             win->dpi = parent->dpi;
             win->dpi_awareness = parent->dpi_awareness;
+            invalidate_child_index( win );
         }
 
         /* if parent belongs to a different thread and the window isn't */
@@ -351,6 +461,11 @@ static int set_parent_window( struct window *win, struct window *parent )
     }
     else  /* move it to parent unlinked list */
     {
+        if (win->is_linked)
+        {
+            invalidate_child_index( win->parent );
+            invalidate_visible_regions( win, NULL );
+        }
         list_remove( &win->entry );  /* unlink it from the previous location */
         list_add_head( &win->parent->unlinked, &win->entry );
         win->is_linked = 0;
@@ -575,6 +690,13 @@ static struct window *create_window( struct window *parent, struct window *owner
     win->is_linked      = 0;
     win->is_layered     = 0;
     win->is_orphan      = 0;
+    win->child_index_valid = 0;
+    win->child_index_moved = 0;
+    win->child_z        = 0;
+    win->child_index    = NULL;
+    win->vis_serial     = 0;
+    win->tree_serial    = 0;
+    memset( win->vis_cache, 0, sizeof(win->vis_cache) );
     win->dpi_awareness  = DPI_AWARENESS_PER_MONITOR_AWARE;
     win->dpi            = 0;
     win->user_data      = 0;
@@ -827,6 +949,176 @@ static int is_point_in_window( struct window *win, int *x, int *y, unsigned int
     return 1;
 }
 
+/* get the range of grid cells covered by a rectangle */
+static void get_child_index_cells( const struct child_index *index, const rectangle_t *rect,
+                                   rectangle_t *cells )
+{
+    cells->left   = (unsigned int)(rect->left - index->bounds.left) / index->cell_width;
+    cells->top    = (unsigned int)(rect->top - index->bounds.top) / index->cell_height;
+    cells->right  = (unsigned int)(rect->right - 1 - index->bounds.left) / index->cell_width + 1;
+    cells->bottom = (unsigned int)(rect->bottom - 1 - index->bounds.top) / index->cell_height + 1;
+}
+
+/* build the spatial index of the children of a window, if it's worth it */
+static void build_child_index( struct window *parent )
+{
+    struct child_index *index;
+    struct window *ptr;
+    rectangle_t bounds = empty_rect, cells;
+    unsigned int count = 0, total = 0, cell_count, size, i, z = 0;
+    int x, y;
+
+    parent->child_index_valid = 1;
+
+    LIST_FOR_EACH_ENTRY( ptr, &parent->children, struct window, entry )
+    {
+        /* the grid is in parent coordinates, don't index children that need DPI mapping */
+        unsigned int from = parent->dpi ? parent->dpi : get_monitor_dpi( ptr );
+        unsigned int to = ptr->dpi ? ptr->dpi : get_monitor_dpi( ptr );
+
+        if (from != to) return;
+        ptr->child_z = z++;
+        if (is_rect_empty( &ptr->visible_rect )) continue;
+        if (!count++) bounds = ptr->visible_rect;
+        else
+        {
+            bounds.left   = min( bounds.left, ptr->visible_rect.left );
+            bounds.top    = min( bounds.top, ptr->visible_rect.top );
+            bounds.right  = max( bounds.right, ptr->visible_rect.right );
+            bounds.bottom = max( bounds.bottom, ptr->visible_rect.bottom );
+        }
+    }
+    if (count < CHILD_INDEX_MIN_COUNT) return;
+
+    if (!(index = mem_alloc( sizeof(*index) ))) return;
+    for (size = 1; size < CHILD_INDEX_MAX_CELLS && size * size * 2 < count; size++) ;
+    index->bounds      = bounds;
+    index->cols        = size;
+    index->rows        = size;
+    index->cell_width  = ((unsigned int)(bounds.right - bounds.left) + size - 1) / size;
+    index->cell_height = ((unsigned int)(bounds.bottom - bounds.top) + size - 1) / size;
+    index->offsets     = NULL;
+    index->windows     = NULL;
+    index->moved_count = 0;
+    cell_count = index->cols * index->rows;
+
+    /* give up if large windows would be duplicated in too many cells */
+    LIST_FOR_EACH_ENTRY( ptr, &parent->children, struct window, entry )
+    {
+        if (is_rect_empty( &ptr->visible_rect )) continue;
+        get_child_index_cells( index, &ptr->visible_rect, &cells );
+        total += (cells.right - cells.left) * (cells.bottom - cells.top);
+        if (total > 4 * count + cell_count) break;
+    }
+
+    if (total > 4 * count + cell_count ||
+        !(index->offsets = mem_alloc( (cell_count + 1) * sizeof(*index->offsets) )) ||
+        !(index->windows = mem_alloc( total * sizeof(*index->windows) )))
+    {
+        free( index->offsets );
+        free( index );
+        return;
+    }
+
+    /* count the windows in each cell, then fill the cells in Z-order */
+    memset( index->offsets, 0, (cell_count + 1) * sizeof(*index->offsets) );
+    LIST_FOR_EACH_ENTRY( ptr, &parent->children, struct window, entry )
+    {
+        if (is_rect_empty( &ptr->visible_rect )) continue;
+        get_child_index_cells( index, &ptr->visible_rect, &cells );
+        for (y = cells.top; y < cells.bottom; y++)
+            for (x = cells.left; x < cells.right; x++) index->offsets[y * index->cols + x + 1]++;
+    }
+    for (i = 0; i < cell_count; i++) index->offsets[i + 1] += index->offsets[i];
+    LIST_FOR_EACH_ENTRY( ptr, &parent->children, struct window, entry )
+    {
+        if (is_rect_empty( &ptr->visible_rect )) continue;
+        get_child_index_cells( index, &ptr->visible_rect, &cells );
+        for (y = cells.top; y < cells.bottom; y++)
+            for (x = cells.left; x < cells.right; x++)
+                index->windows[index->offsets[y * index->cols + x]++] = ptr;
+    }
+    /* filling moved each offset to the start of the next cell, shift them back */
+    memmove( index->offsets + 1, index->offsets, cell_count * sizeof(*index->offsets) );
+    index->offsets[0] = 0;
+
+    parent->child_index = index;
+}
+
+/* update the spatial index of the parent of a window after its visible rect changed */
+static void update_child_index( struct window *win )
+{
+    struct child_index *index = win->parent->child_index;
+    unsigned int i;
+
+    if (!index) invalidate_child_index( win->parent );
+    else if (win->child_index_moved) return;  /* already tracked */
+    else if (index->moved_count == ARRAY_SIZE(index->moved)) invalidate_child_index( win->parent );
+    else
+    {
+        /* keep the moved children out of the grid cells, and check them for every point instead */
+        for (i = index->moved_count; i && index->moved[i - 1]->child_z > win->child_z; i--)
+            index->moved[i] = index->moved[i - 1];
+        index->moved[i] = win;
+        index->moved_count++;
+        win->child_index_moved = 1;
+    }
+}
+
+/* iterator over the children of a window that may contain a point, in Z-order */
+struct child_iterator
+{
+    struct window  *parent;
+    struct window **cell;   /* current position in the index cell, if using the index */
+    struct window **end;    /* end of the index cell */
+    struct window **moved;  /* current position in the index moved children */
+    struct window **moved_end; /* end of the index moved children */
+    struct list    *entry;  /* current position in the children list otherwise */
+};
+
+static struct window *next_child_at_point( struct child_iterator *iter )
+{
+    if (iter->cell)
+    {
+        /* merge the moved children with the cell, in Z-order */
+        while (iter->cell < iter->end && (*iter->cell)->child_index_moved) iter->cell++;
+        if (iter->moved < iter->moved_end &&
+            (iter->cell == iter->end || (*iter->moved)->child_z < (*iter->cell)->child_z))
+            return *iter->moved++;
+        return iter->cell < iter->end ? *iter->cell++ : NULL;
+    }
+    if (!(iter->entry = list_next( &iter->parent->children, iter->entry ))) return NULL;
+    return LIST_ENTRY( iter->entry, struct window, entry );
+}
+
+/* start iterating over the children that may contain a point (in parent client coords) */
+static struct window *first_child_at_point( struct child_iterator *iter, struct window *parent, int x, int y )
+{
+    struct child_index *index;
+    unsigned int col, row;
+
+    if (!parent->child_index_valid) build_child_index( parent );
+
+    iter->parent = parent;
+    iter->entry  = &parent->children;
+    iter->cell   = iter->end = NULL;
+
+    if ((index = parent->child_index))
+    {
+        iter->cell = iter->end = index->windows;
+        iter->moved = index->moved;
+        iter->moved_end = index->moved + index->moved_count;
+        if (point_in_rect( &index->bounds, x, y ))
+        {
+            col = (unsigned int)(x - index->bounds.left) / index->cell_width;
+            row = (unsigned int)(y - index->bounds.top) / index->cell_height;
+            iter->cell = index->windows + index->offsets[row * index->cols + col];
+            iter->end  = index->windows + index->offsets[row * index->cols + col + 1];
+        }
+    }
+    return next_child_at_point( iter );
+}
+
 /* fill an array with the handles of the children of a specified window */
 static unsigned int get_children_windows( struct window *parent, atom_t atom, thread_id_t tid,
                                           user_handle_t *handles, unsigned int max_count )
@@ -853,9 +1145,10 @@ static unsigned int get_children_windows( struct window *parent, atom_t atom, th
 /* find child of 'parent' that contains the given point (in parent-relative coords) */
 static struct window *child_window_from_point( struct window *parent, int x, int y )
 {
+    struct child_iterator iter;
     struct window *ptr;
 
-    LIST_FOR_EACH_ENTRY( ptr, &parent->children, struct window, entry )
+    for (ptr = first_child_at_point( &iter, parent, x, y ); ptr; ptr = next_child_at_point( &iter ))
     {
         int x_child = x, y_child = y;
 
@@ -877,9 +1170,10 @@ static struct window *child_window_from_point( struct window *parent, int x, int
 static int get_window_children_from_point( struct window *parent, int x, int y,
                                            struct user_handle_array *array )
 {
+    struct child_iterator iter;
     struct window *ptr;
 
-    LIST_FOR_EACH_ENTRY( ptr, &parent->children, struct window, entry )
+    for (ptr = first_child_at_point( &iter, parent, x, y ); ptr; ptr = next_child_at_point( &iter ))
     {
         int x_child = x, y_child = y;
 
@@ -902,11 +1196,12 @@ static int get_window_children_from_point( struct window *parent, int x, int y,
 /* get handle of root of top-most window containing point */
 user_handle_t shallow_window_from_point( struct desktop *desktop, int x, int y )
 {
+    struct child_iterator iter;
     struct window *ptr;
 
     if (!desktop->top_window) return 0;
 
-    LIST_FOR_EACH_ENTRY( ptr, &desktop->top_window->children, struct window, entry )
+    for (ptr = first_child_at_point( &iter, desktop->top_window, x, y ); ptr; ptr = next_child_at_point( &iter ))
     {
         int x_child = x, y_child = y;
 
@@ -1078,6 +1373,7 @@ static struct region *clip_children( struct window *parent, struct window *last,
             return NULL;
         }
         offset_region( tmp, offset_x, offset_y );
+        visible_region_ops++;
         if (!(region = subtract_region( region, region, tmp ))) break;
         if (is_region_empty( region )) break;
     }
@@ -1117,7 +1413,7 @@ static inline struct window *get_top_clipping_window( struct window *win )
 
 
 /* compute the visible region of a window, in window coordinates */
-static struct region *get_visible_region( struct window *win, unsigned int flags )
+static struct region *compute_visible_region( struct window *win, unsigned int flags )
 {
     struct region *tmp = NULL, *region;
     int offset_x, offset_y;
@@ -1181,6 +1477,7 @@ static struct region *get_visible_region( struct window *win, unsigned int flags
             offset_region( region, win->client_rect.left, win->client_rect.top );
             set_region_client_rect( tmp, win );
             if (win->win_region && !intersect_window_region( tmp, win )) goto error;
+            visible_region_ops++;
             if (!intersect_region( region, region, tmp )) goto error;
             if (is_region_empty( region )) break;
         }
@@ -1196,6 +1493,69 @@ error:
 }
 
 
+/* check whether the visible region of a window can be cached, and whether a cached one is still valid */
+static int is_visible_cache_valid( struct window *win, unsigned __int64 serial )
+{
+    if (win->vis_serial > serial) return 0;
+    for (; !is_desktop_window( win ); win = win->parent)
+    {
+        /* unlinked windows are clipped by all their siblings */
+        if (!win->is_linked) return 0;
+        if (win->tree_serial > serial) return 0;
+    }
+    return win->tree_serial <= serial;
+}
+
+/* get the visible region of a window, in window coordinates, using the cache when possible */
+static struct region *get_visible_region( struct window *win, unsigned int flags )
+{
+    struct visible_cache *cache, entry;
+    struct region *region;
+    unsigned int i, ops;
+
+    /* the region only depends on these flags */
+    flags &= DCX_WINDOW | DCX_CLIPCHILDREN | DCX_PARENTCLIP;
+    if (flags & DCX_PARENTCLIP) return compute_visible_region( win, flags );
+
+    for (i = 0; i < VISIBLE_CACHE_SIZE; i++)
+    {
+        cache = &win->vis_cache[i];
+        if (!cache->region || cache->flags != flags) continue;
+        if (!is_visible_cache_valid( win, cache->serial )) break;
+        visible_cache_hits++;
+        visible_region_ops_saved += cache->ops;
+        if (!(region = create_empty_region())) return NULL;
+        if (!copy_region( region, cache->region ))
+        {
+            free_region( region );
+            return NULL;
+        }
+        return region;
+    }
+
+    visible_cache_misses++;
+    ops = visible_region_ops;
+    if (!(region = compute_visible_region( win, flags ))) return NULL;
+    if (!is_visible_cache_valid( win, visible_serial )) return region;
+
+    /* replace the outdated entry for these flags, or the least recently computed one */
+    if (i == VISIBLE_CACHE_SIZE) i--;
+    entry = win->vis_cache[i];
+    if (!entry.region && !(entry.region = create_empty_region())) return region;
+    if (!copy_region( entry.region, region ))
+    {
+        free_region( entry.region );
+        win->vis_cache[i].region = NULL;
+        return region;
+    }
+    entry.flags  = flags;
+    entry.ops    = visible_region_ops - ops;
+    entry.serial = visible_serial;
+    memmove( win->vis_cache + 1, win->vis_cache, i * sizeof(entry) );
+    win->vis_cache[0] = entry;
+    return region;
+}
+
 /* clip all children with a custom pixel format out of the visible region */
 static struct region *clip_pixel_format_children( struct window *parent, struct region *parent_clip,
                                                   struct region *region, int offset_x, int offset_y )
@@ -1810,9 +2170,12 @@ static void set_window_pos( struct window *win, struct window *previous,
     win->visible_rect = *visible_rect;
     win->surface_rect = *surface_rect;
     win->client_rect  = *client_rect;
+    if (win->parent && win->is_linked && !is_rect_equal( &old_visible_rect, visible_rect ))
+        update_child_index( win );
     if (!(swp_flags & SWP_NOZORDER) && win->parent) zorder_changed |= link_window( win, previous );
     if (swp_flags & SWP_SHOWWINDOW) win->style |= WS_VISIBLE;
     else if (swp_flags & SWP_HIDEWINDOW) win->style &= ~WS_VISIBLE;
+    invalidate_visible_regions( win, &old_visible_rect );
 
     /* keep children at the same position relative to top right corner when the parent is mirrored */
     if (win->ex_style & WS_EX_LAYOUTRTL)
@@ -1821,12 +2184,16 @@ static void set_window_pos( struct window *win, struct window *previous,
         int old_size = old_client_rect.right - old_client_rect.left;
         int new_size = win->client_rect.right - win->client_rect.left;
 
-        if (old_size != new_size) LIST_FOR_EACH_ENTRY( child, &win->children, struct window, entry )
+        if (old_size != new_size)
         {
-            offset_rect( &child->window_rect, new_size - old_size, 0 );
-            offset_rect( &child->visible_rect, new_size - old_size, 0 );
-            offset_rect( &child->surface_rect, new_size - old_size, 0 );
-            offset_rect( &child->client_rect, new_size - old_size, 0 );
+            LIST_FOR_EACH_ENTRY( child, &win->children, struct window, entry )
+            {
+                offset_rect( &child->window_rect, new_size - old_size, 0 );
+                offset_rect( &child->visible_rect, new_size - old_size, 0 );
+                offset_rect( &child->surface_rect, new_size - old_size, 0 );
+                offset_rect( &child->client_rect, new_size - old_size, 0 );
+            }
+            invalidate_child_index( win );
         }
     }
 
@@ -1968,6 +2335,7 @@ static void set_window_region( struct window *win, struct region *region, int re
 
     if (win->win_region) free_region( win->win_region );
     win->win_region = region;
+    invalidate_visible_regions( win, NULL );
 
     /* expose anything revealed by the change */
     if (old_vis_rgn && ((exposed_rgn = expose_window( win, &win->window_rect, old_vis_rgn, 0 ))))
@@ -1993,6 +2361,7 @@ void free_window_handle( struct window *win )
     {
         struct region *vis_rgn = get_visible_region( win, DCX_WINDOW );
         win->style &= ~WS_VISIBLE;
+        invalidate_visible_regions( win, NULL );
         if (vis_rgn)
         {
             struct region *exposed_rgn = expose_window( win, &win->window_rect, vis_rgn, 0 );
@@ -2279,6 +2648,8 @@ DECL_HANDLER(set_window_info)
         else win->ex_style = (req->ex_style & ~WS_EX_TOPMOST) | (win->ex_style & WS_EX_TOPMOST);
         if (!(win->ex_style & WS_EX_LAYERED)) win->is_layered = 0;
     }
+    if (win->style != reply->old_style || win->ex_style != reply->old_ex_style)
+        invalidate_visible_regions( win, NULL );
     if (req->flags & SET_WIN_ID) win->id = req->extra_value;
     if (req->flags & SET_WIN_INSTANCE) win->instance = req->instance;
     if (req->flags & SET_WIN_UNICODE) win->is_unicode = req->is_unicode;
@@ -2810,6 +3181,8 @@ DECL_HANDLER(update_window_zorder)
         {
             list_remove( &win->entry );
             list_add_before( &ptr->entry, &win->entry );
+            invalidate_child_index( win->parent );
+            invalidate_visible_regions( win, NULL );
         }
         break;
     }